@@ -54,6 +54,55 @@ namespace ntr::fmt {
         u32 block_size;
     };
 
+    // A whole block with strings (referenced by their offsets in it) read at once, so getting each string is just pointer arithmetic
+    // The strings are views into the block's memory, which stays alive as long as any table sharing it does
+
+    class StringTable {
+        private:
+            std::shared_ptr<char> data;
+            size_t data_size;
+
+        public:
+            StringTable() : data(), data_size(0) {}
+
+            inline Result ReadFrom(fs::BinaryFile &bf, const size_t offset, const size_t size) {
+                // Keep a null terminator past the end, for any unterminated string at the end
+                std::shared_ptr<char> data(util::NewArray<char>(size + 1), std::default_delete<char[]>());
+
+                NTR_R_TRY(bf.SetAbsoluteOffset(offset));
+                NTR_R_TRY(bf.ReadDataExact(data.get(), size));
+
+                this->data = std::move(data);
+                this->data_size = size;
+                NTR_R_SUCCEED();
+            }
+
+            inline bool GetString(const size_t offset, std::string_view &out_str) const {
+                if(offset >= this->data_size) {
+                    return false;
+                }
+
+                const auto str = this->data.get() + offset;
+                out_str = std::string_view(str, std::strlen(str));
+                return true;
+            }
+
+            // Tables usually also hold the offsets to their strings
+            template<typename T>
+            inline bool Get(const size_t offset, T &out_t) const {
+                if((offset + sizeof(T)) > this->data_size) {
+                    return false;
+                }
+
+                std::memcpy(std::addressof(out_t), this->data.get() + offset, sizeof(T));
+                return true;
+            }
+
+            inline size_t GetSize() const {
+                return this->data_size;
+            }
+    };
+
     enum class WaveType : u8 {
         PCM8,
         PCM16,
@@ -31,15 +31,24 @@ namespace ntr::fmt {
         CharacterDataBlock char_data;
         CharacterPositionBlock char_pos;
         u8 *data;
+        std::shared_ptr<u8> data_view;
 
-        NCGR() : data(nullptr) {}
+        NCGR() : data(nullptr), data_view() {}
         NCGR(const NCGR&) = delete;
 
         ~NCGR() {
-            if(this->data != nullptr) {
+            this->DisposeData();
+        }
+
+        // Data might be borrowed from the file (see fs::FileHandle::GetView), in which case it must not be deleted
+        inline void DisposeData() {
+            if(this->data_view) {
+                this->data_view.reset();
+            }
+            else if(this->data != nullptr) {
                 delete[] this->data;
-                this->data = nullptr;
             }
+            this->data = nullptr;
         }
 
         inline constexpr void ComputeDimensions(u32 &out_width, u32 &out_height) {
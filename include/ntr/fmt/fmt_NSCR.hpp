@@ -21,15 +21,24 @@ namespace ntr::fmt {
         Header header;
         ScreenDataBlock screen_data;
         u8 *data;
+        std::shared_ptr<u8> data_view;
 
-        NSCR() : data(nullptr) {}
+        NSCR() : data(nullptr), data_view() {}
         NSCR(const NSCR&) = delete;
 
         ~NSCR() {
-            if(this->data != nullptr) {
+            this->DisposeData();
+        }
+
+        // Data might be borrowed from the file (see fs::FileHandle::GetView), in which case it must not be deleted
+        inline void DisposeData() {
+            if(this->data_view) {
+                this->data_view.reset();
+            }
+            else if(this->data != nullptr) {
                 delete[] this->data;
-                this->data = nullptr;
             }
+            this->data = nullptr;
         }
 
         Result ValidateImpl(const std::string &path, std::shared_ptr<fs::FileHandle> file_handle, const fs::FileCompression comp) override;
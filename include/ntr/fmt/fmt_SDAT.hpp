@@ -2,6 +2,7 @@
 #pragma once
 #include <ntr/fmt/fmt_Common.hpp>
 #include <ntr/fs/fs_Stdio.hpp>
+#include <ntr/fs/fs_Subrange.hpp>
 
 namespace ntr::fmt {
 
@@ -19,9 +20,11 @@ namespace ntr::fmt {
             u8 unk_pad[16];
         };
 
+        // Symbol names are views into the symbol block's string table
+
         struct SymbolRecordEntry {
             u32 name_offset;
-            std::string name;
+            std::string_view name;
         };
 
         struct SymbolRecord {
@@ -31,7 +34,7 @@ namespace ntr::fmt {
 
         struct SequenceArchiveSymbolRecordEntry {
             u32 name_offset;
-            std::string name;
+            std::string_view name;
             u32 subrecord_offset;
             SymbolRecord subrecord;
         };
@@ -157,6 +160,7 @@ namespace ntr::fmt {
 
         Header header;
         SymbolBlock symb;
+        StringTable symb_table;
         InfoBlock info;
         FileAllocationTableBlock fat;
         FileBlock file;
@@ -188,16 +192,23 @@ namespace ntr::fmt {
         }
 
         Result LocateFile(const std::string &path, u32 &out_file_id);
+
+        Result LocateExternalFsFile(const std::string &path, u32 &out_file_id) override {
+            return this->LocateFile(path, out_file_id);
+        }
         
         Result ValidateImpl(const std::string &path, std::shared_ptr<fs::FileHandle> file_handle, const fs::FileCompression comp) override;
         Result ReadImpl(const std::string &path, std::shared_ptr<fs::FileHandle> file_handle, const fs::FileCompression comp) override;
 
+        // Overwrites the edited files and their FAT records directly in the read file, only if all of them fit in their original slots (otherwise nothing is written)
+        Result SaveFileSystemInPlace(const std::vector<fs::ExternalFsFile> &ext_fs_files, bool &out_saved);
+
         Result SaveFileSystem() override;
     };
 
     struct SDATFileHandle : public fs::ExternalFsFileHandle<SDAT> {
         u32 file_id;
-        fs::BinaryFile base_bf;
+        fs::SubrangeFileHandle subrange;
 
         SDATFileHandle(std::shared_ptr<SDAT> sdat) : fs::ExternalFsFileHandle<SDAT>(sdat) {}
 
@@ -210,12 +221,14 @@ namespace ntr::fmt {
         }
 
         bool ExistsImpl(const std::string &path, size_t &out_size) override;
+        bool GetSubrangeImpl(const std::string &path, std::shared_ptr<fs::FileHandle> &out_parent_handle, std::string &out_parent_path, size_t &out_offset, size_t &out_size) override;
         Result OpenImpl(const std::string &path) override;
         Result GetSizeImpl(size_t &out_soze) override;
         Result SetOffsetImpl(const size_t offset, const fs::Position pos) override;
         Result GetOffsetImpl(size_t &out_offst) override;
         Result ReadImpl(void *read_buf, const size_t read_size, size_t &out_read_size) override;
         Result CloseImpl() override;
+        Result GetViewImpl(const size_t offset, const size_t size, std::shared_ptr<u8> &out_view) override;
     };
 
 }
\ No newline at end of file
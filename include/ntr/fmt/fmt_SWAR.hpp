@@ -37,6 +37,7 @@ namespace ntr::fmt {
         SWAR(const SWAR&) = delete;
 
         Result ReadSampleData(const Sample sample, u8 *out_sample_data);
+        Result ReadSampleData(const Sample sample, std::shared_ptr<u8> &out_sample_data);
         Result WriteSampleData(const Sample sample, const u8 *sample_data, size_t sample_data_size, const std::string &path, std::shared_ptr<fs::FileHandle> file_handle);
 
         inline Result WriteSampleData(const Sample sample, const u8 *sample_data, size_t sample_data_size, std::shared_ptr<fs::FileHandle> file_handle) {
@@ -1,6 +1,7 @@
 
 #pragma once
 #include <ntr/fs/fs_Stdio.hpp>
+#include <ntr/fs/fs_Subrange.hpp>
 
 namespace ntr::fmt::nfs {
 
@@ -26,6 +27,7 @@ namespace ntr::fmt::nfs {
     };
 
     struct NitroFile : public NitroEntryBase {
+        u32 id;
         size_t offset;
         size_t size;
 
@@ -42,8 +44,10 @@ namespace ntr::fmt::nfs {
 
     struct NitroFsFileFormat : public fs::ExternalFsFileFormat {
         nfs::NitroDirectory nitro_fs;
+        // If compressed, files inside can be read by streaming decompression from checkpoints every this many bytes, instead of decompressing the whole container (0 disables this)
+        size_t file_checkpoint_interval;
 
-        NitroFsFileFormat() {}
+        NitroFsFileFormat() : file_checkpoint_interval(0) {}
 
         virtual size_t GetBaseOffset() {
             return 0;
@@ -59,16 +63,29 @@ namespace ntr::fmt::nfs {
         virtual Result OnFileSystemWrite(fs::BinaryFile &w_bf, const ssize_t size_diff) = 0;
 
         Result LookupFile(const std::string &path, NitroFile &out_file) const;
+
+        Result LocateExternalFsFile(const std::string &path, u32 &out_file_id) override {
+            NitroFile file = {};
+            NTR_R_TRY(this->LookupFile(path, file));
+            out_file_id = file.id;
+            NTR_R_SUCCEED();
+        }
+
         Result GetName(const NitroEntryBase &entry, std::string &out_name) const;
         
         inline Result DoWithReadFile(std::function<Result(fs::BinaryFile&)> fn) const {
             fs::BinaryFile bf;
+            bf.SetStreamingDecompression(this->file_checkpoint_interval > 0);
+            bf.SetDecompressionCheckpointInterval(this->file_checkpoint_interval);
             NTR_R_TRY(bf.Open(this->read_file_handle, this->read_path, fs::OpenMode::Read, this->comp));
 
             NTR_R_TRY(fn(bf));
             NTR_R_SUCCEED();
         }
         
+        // Overwrites the edited files and their FAT entries directly in the read file, only if all of them fit in their original slots (otherwise nothing is written)
+        Result SaveFileSystemInPlace(const std::vector<std::pair<fs::ExternalFsFile, NitroFile>> &nfs_files, bool &out_saved);
+
         Result SaveFileSystem() override;
     };
 
@@ -77,9 +94,12 @@ namespace ntr::fmt::nfs {
         static_assert(std::is_base_of_v<NitroFsFileFormat, T>);
 
         NitroFile file;
+        // Files in uncompressed containers are read straight from the outermost file, otherwise through the (decompressing) container file
+        bool from_subrange;
+        fs::SubrangeFileHandle subrange;
         fs::BinaryFile base_bf;
 
-        NitroFsFileHandle(std::shared_ptr<T> nitro_fs_file) : fs::ExternalFsFileHandle<T>(nitro_fs_file) {}
+        NitroFsFileHandle(std::shared_ptr<T> nitro_fs_file) : fs::ExternalFsFileHandle<T>(nitro_fs_file), from_subrange(false) {}
 
         bool ExistsImpl(const std::string &path, size_t &out_size) override {
             NitroFile file = {};
@@ -92,9 +112,35 @@ namespace ntr::fmt::nfs {
             }
         }
 
+        bool GetSubrangeImpl(const std::string &path, std::shared_ptr<fs::FileHandle> &out_parent_handle, std::string &out_parent_path, size_t &out_offset, size_t &out_size) override {
+            if(this->ext_fs_file->comp != fs::FileCompression::None) {
+                return false;
+            }
+
+            NitroFile file = {};
+            if(this->ext_fs_file->LookupFile(path, file).IsFailure()) {
+                return false;
+            }
+
+            out_parent_handle = this->ext_fs_file->read_file_handle;
+            out_parent_path = this->ext_fs_file->read_path;
+            out_offset = this->ext_fs_file->GetBaseOffset() + file.offset;
+            out_size = file.size;
+            return true;
+        }
+
         Result OpenImpl(const std::string &path) override {
             NTR_R_TRY(this->ext_fs_file->LookupFile(path, this->file));
 
+            this->from_subrange = this->ext_fs_file->comp == fs::FileCompression::None;
+            if(this->from_subrange) {
+                this->subrange.SetRange(this->ext_fs_file->read_file_handle, this->ext_fs_file->read_path, this->ext_fs_file->GetBaseOffset() + this->file.offset, this->file.size);
+                return this->subrange.Open(path, fs::OpenMode::Read);
+            }
+
+            const auto checkpoint_interval = this->ext_fs_file->file_checkpoint_interval;
+            this->base_bf.SetStreamingDecompression(checkpoint_interval > 0);
+            this->base_bf.SetDecompressionCheckpointInterval(checkpoint_interval);
             NTR_R_TRY(this->base_bf.Open(this->ext_fs_file->read_file_handle, this->ext_fs_file->read_path, fs::OpenMode::Read, this->ext_fs_file->comp));
             const auto f_base_offset = this->ext_fs_file->GetBaseOffset() + this->file.offset;
             NTR_R_TRY(this->base_bf.SetAbsoluteOffset(f_base_offset));
@@ -108,6 +154,10 @@ namespace ntr::fmt::nfs {
         }
 
         Result SetOffsetImpl(const size_t offset, const fs::Position pos) override {
+            if(this->from_subrange) {
+                return this->subrange.SetOffset(offset, pos);
+            }
+
             const auto f_base_offset = this->ext_fs_file->GetBaseOffset() + this->file.offset;
             
             size_t base_bf_abs_offset;
@@ -138,6 +188,10 @@ namespace ntr::fmt::nfs {
         }
 
         Result GetOffsetImpl(size_t &out_offset) override {
+            if(this->from_subrange) {
+                return this->subrange.GetOffset(out_offset);
+            }
+
             const auto f_base_offset = this->ext_fs_file->GetBaseOffset() + this->file.offset;
             
             size_t base_bf_abs_offset;
@@ -147,6 +201,10 @@ namespace ntr::fmt::nfs {
         }
 
         Result ReadImpl(void *read_buf, const size_t read_size, size_t &out_read_size) override {
+            if(this->from_subrange) {
+                return this->subrange.Read(read_buf, read_size, out_read_size);
+            }
+
             auto actual_read_size = read_size;
             size_t offset;
             NTR_R_TRY(this->GetOffsetImpl(offset));
@@ -163,8 +221,25 @@ namespace ntr::fmt::nfs {
         }
 
         Result CloseImpl() override {
+            if(this->from_subrange) {
+                return this->subrange.Close();
+            }
+
             return this->base_bf.Close();
         }
+
+        Result GetViewImpl(const size_t offset, const size_t size, std::shared_ptr<u8> &out_view) override {
+            if(this->from_subrange) {
+                return this->subrange.GetView(offset, size, out_view);
+            }
+
+            if((offset + size) > this->file.size) {
+                NTR_R_FAIL(ResultEndOfData);
+            }
+
+            const auto f_base_offset = this->ext_fs_file->GetBaseOffset() + this->file.offset;
+            return this->base_bf.GetView(f_base_offset + offset, size, out_view);
+        }
     };
 
 }
\ No newline at end of file
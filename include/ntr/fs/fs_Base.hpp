@@ -1,24 +1,46 @@
 
 #pragma once
-#include <ntr/ntr_Include.hpp>
+#include <ntr/util/util_Memory.hpp>
 
 namespace ntr::fs {
 
     constexpr size_t CopyBufferSize = 0x10000;
     constexpr size_t ReallocBufferSize = 0x10000;
+    constexpr size_t DefaultReadAheadBufferSize = 0x1000;
+    constexpr size_t StreamingDecompressionBufferSize = 0x1000;
+    constexpr size_t DefaultDecompressionCheckpointInterval = 0x10000;
+    constexpr size_t FillBufferSize = 0x200;
+    constexpr size_t ExternalFsMemoryBlockSize = 0x1000;
+
+    #ifdef NTR_HOST_BUILD
+    constexpr size_t DefaultDecompressedImageCacheSize = 64_MB;
+    constexpr size_t PooledCopyBufferSize = 1_MB;
+    constexpr size_t DefaultExternalFsMemoryBudget = 32_MB;
+    constexpr size_t DefaultPipelinedCopyDepth = 4;
+    constexpr size_t DefaultPipelinedCopyChunkSize = 1_MB;
+    constexpr size_t DefaultDeferredCompressionMemoryBudget = 256_MB;
+    #else
+    constexpr size_t DefaultDecompressedImageCacheSize = 2_MB;
+    constexpr size_t PooledCopyBufferSize = CopyBufferSize;
+    constexpr size_t DefaultExternalFsMemoryBudget = 256_KB;
+    constexpr size_t DefaultDeferredCompressionMemoryBudget = 1_MB;
+    #endif
 
     enum class OpenMode : u8 {
         Read,
         Write,
-        Update
+        // Appends to the end of the file
+        Update,
+        // Reads and overwrites anywhere in an existing file (neither truncating nor creating it)
+        ReadWrite
     };
 
     inline constexpr bool CanReadWithMode(const OpenMode mode) {
-        return mode == OpenMode::Read;
+        return (mode == OpenMode::Read) || (mode == OpenMode::ReadWrite);
     }
 
     inline constexpr bool CanWriteWithMode(const OpenMode mode) {
-        return (mode == OpenMode::Write) || (mode == OpenMode::Update);
+        return (mode == OpenMode::Write) || (mode == OpenMode::Update) || (mode == OpenMode::ReadWrite);
     }
 
     enum class Position : u8 {
@@ -31,6 +53,16 @@ namespace ntr::fs {
         LZ77
     };
 
+    struct ReadSegment {
+        void *buf;
+        size_t size;
+    };
+
+    struct WriteSegment {
+        const void *buf;
+        size_t size;
+    };
+
     struct FileHandle {
         virtual bool Exists(const std::string &path, size_t &out_size) = 0;
         virtual Result Open(const std::string &path, const OpenMode mode) = 0;
@@ -40,6 +72,83 @@ namespace ntr::fs {
         virtual Result Read(void *read_buf, const size_t read_size, size_t &out_read_size) = 0;
         virtual Result Write(const void *write_buf, const size_t write_size) = 0;
         virtual Result Close() = 0;
+
+        // Scatter/gather variants of Read/Write: handles able to do them in a single operation should override these (the default is a plain loop)
+
+        virtual Result ReadV(const ReadSegment *segments, const size_t segment_count, size_t &out_read_size) {
+            out_read_size = 0;
+            for(size_t i = 0; i < segment_count; i++) {
+                const auto &segment = segments[i];
+                if(segment.size == 0) {
+                    continue;
+                }
+
+                size_t read_size;
+                const auto rc = this->Read(segment.buf, segment.size, read_size);
+                if(rc.IsFailure()) {
+                    // Like Read, only fail if nothing could be read at all
+                    if(out_read_size == 0) {
+                        return rc;
+                    }
+                    break;
+                }
+
+                out_read_size += read_size;
+                if(read_size < segment.size) {
+                    break;
+                }
+            }
+
+            NTR_R_SUCCEED();
+        }
+
+        virtual Result WriteV(const WriteSegment *segments, const size_t segment_count) {
+            for(size_t i = 0; i < segment_count; i++) {
+                const auto &segment = segments[i];
+                if(segment.size > 0) {
+                    NTR_R_TRY(this->Write(segment.buf, segment.size));
+                }
+            }
+
+            NTR_R_SUCCEED();
+        }
+
+        // Writes the same byte count times: handles able to do this without actually writing every byte (like extending a file with zeros) should override this
+        virtual Result WriteFill(const u8 value, const size_t count) {
+            u8 fill_buf[FillBufferSize];
+            std::memset(fill_buf, value, std::min(count, FillBufferSize));
+
+            auto cur_left_count = count;
+            while(cur_left_count > 0) {
+                const auto write_count = std::min(cur_left_count, FillBufferSize);
+                NTR_R_TRY(this->Write(fill_buf, write_count));
+                cur_left_count -= write_count;
+            }
+
+            NTR_R_SUCCEED();
+        }
+
+        // Optional: handles backed by a native file can expose its descriptor (after flushing anything they buffer) so that copies between them are done by the OS
+        // Such copies don't go through Write, and the handle is always moved to the resulting offset with SetOffset afterwards
+        virtual bool GetNativeFileDescriptor(int &out_fd) {
+            return false;
+        }
+
+        // Optional: handles able to atomically replace one of their files with an already written stdio file (like renaming it over) should override this
+        // The stdio file must be gone after succeeding, and untouched after failing (saves then fall back to copying its data over the file)
+        virtual Result ReplaceFile(const std::string &path, const std::string &new_stdio_path) {
+            NTR_R_FAIL(ResultReplaceNotSupported);
+        }
+
+        // Optional: handles whose files are just plain (uncompressed) ranges of another file can tell where, so that nested files are read straight from the outermost file
+        virtual bool GetSubrange(const std::string &path, std::shared_ptr<FileHandle> &out_parent_handle, std::string &out_parent_path, size_t &out_offset, size_t &out_size) {
+            return false;
+        }
+
+        // Optional: handles backed by memory can lend their data instead of copying it (the view keeps that memory alive)
+        virtual Result GetView(const size_t offset, const size_t size, std::shared_ptr<u8> &out_view) {
+            NTR_R_FAIL(ResultViewNotSupported);
+        }
     };
 
     struct FileFormat {
@@ -89,11 +198,55 @@ namespace ntr::fs {
     void SetExternalFsDirectory(const std::string &path);
     std::string &GetExternalFsDirectory();
 
+    // A file written (staged) outside its format until the next save, either in memory or as a stdio file
+    struct ExternalFsFile {
+        u32 file_id;
+        std::string ext_fs_path;
+        size_t size;
+        // Only set while staged in memory (once spilled, the data is at ext_fs_path)
+        std::shared_ptr<util::ChunkedBuffer> mem_data;
+        u32 open_count;
+        // Least recently opened files are spilled first
+        u64 last_use;
+
+        inline bool IsInMemory() const {
+            return this->mem_data != nullptr;
+        }
+    };
+
     struct ExternalFsFileFormat : public FileFormat {
         u32 ext_fs_id;
         std::string ext_fs_root_path;
+        // Staged files by their path inside the format: kept up to date by ExternalFsFileHandle, so saves don't need to scan the external fs
+        std::map<std::string, ExternalFsFile> ext_fs_files;
+        // Staged files are kept in memory up to this size in total, spilling to stdio files beyond it (0 always stages them as stdio files)
+        size_t ext_fs_mem_budget;
+        u64 ext_fs_use_count;
 
         ExternalFsFileFormat();
+
+        // Format-specific ID of a file inside, which saves use to find it again
+        virtual Result LocateExternalFsFile(const std::string &path, u32 &out_file_id) = 0;
+
+        inline ExternalFsFile *FindExternalFsFile(const std::string &path) {
+            auto it = this->ext_fs_files.find(path);
+            if(it != this->ext_fs_files.end()) {
+                return std::addressof(it->second);
+            }
+            else {
+                return nullptr;
+            }
+        }
+
+        inline size_t GetExternalFsMemorySize() const {
+            size_t mem_size = 0;
+            for(const auto &[path, ext_fs_file] : this->ext_fs_files) {
+                if(ext_fs_file.IsInMemory()) {
+                    mem_size += ext_fs_file.mem_data->GetSize();
+                }
+            }
+            return mem_size;
+        }
         
         inline std::string GetExternalFsPath(const std::string &path) {
             return this->ext_fs_root_path + "/" + path;
@@ -6,26 +6,89 @@
 
 namespace ntr::fs {
 
+    // Level used when compressed files are written back
+    void SetLzCompressionLevel(const util::LzCompressionLevel level);
+
+    // Compressed files opened for writing while this is enabled aren't even opened until the next flush, which compresses all of them together (see util::LzCompressBatch) and only then writes them (so they keep their old contents until then)
+    // Flushes happen on FlushDeferredCompression (container saves do it first), when a BinaryFile opens the path of a pending file (through any handle) and when the pending files exceed mem_budget in total (also the batch memory budget)
+    // Disabling this only stops deferring files opened from then on: files already pending still wait for a flush
+    // Handles of pending files are opened to write them back, so they must not be left open elsewhere (errors opening them also only show up then)
+    // Files that fail to be compressed or written back stay pending, so a failed flush can be retried without losing their data
+    void SetDeferredCompression(const bool enable, const size_t thread_count = 0, const size_t mem_budget = DefaultDeferredCompressionMemoryBudget);
+    Result FlushDeferredCompression();
+
+    // Decompressed images of files opened for reading are shared between all BinaryFiles with the same handle and path,
+    // and the most recently used ones are kept alive (up to this total size) so reopening them doesn't decompress them again
+    // (clearing also drops any cached streaming decompression checkpoints)
+    void SetDecompressedImageCacheSize(const size_t size);
+    void ClearDecompressedImageCache();
+    // Needed when a file is modified without opening it for writing (like replacing it)
+    void InvalidateDecompressedImageCache(const std::string &path);
+
+    #ifdef NTR_HOST_BUILD
+    // Copies spanning more than one chunk are pipelined: a reader thread fills a ring of this many chunks while the copying thread writes them out
+    // (a depth below 2 disables it, copying chunk by chunk on the calling thread instead)
+    // This only happens when both files are, or are ranges of, different plain native files, since nothing else is known to be safe to use from two threads
+    void SetPipelinedCopy(const size_t depth, const size_t chunk_size);
+    #endif
+
     class BinaryFile {
         private:
             std::shared_ptr<FileHandle> file_handle;
+            std::string path;
             bool ok;
             OpenMode mode;
             FileCompression comp;
             util::LzVersion comp_lz_ver;
-            u8 *dec_file_data;
+            bool comp_deferrable;
+            bool comp_deferred;
+            // Compressed files are either fully decompressed here (reading)...
+            std::shared_ptr<u8> dec_file_data;
+            // ...or written here, only put together when saving (writing)
+            util::ChunkedBuffer dec_file_chunks;
             size_t dec_file_offset;
             size_t dec_file_size;
-            size_t dec_file_buf_size;
-
-            Result LoadDecompressedData();
+            u8 *ra_buf;
+            size_t ra_buf_size;
+            size_t ra_window_offset;
+            size_t ra_window_size;
+            size_t ra_cur_offset;
+            bool ra_window_valid;
+            size_t ra_hit_count;
+            size_t ra_miss_count;
+            u8 *span_buf;
+            size_t span_buf_size;
+            bool dec_streaming;
+            util::LzDecompressor *lz_dec;
+            u8 *lz_enc_buf;
+            size_t lz_enc_buf_offset;
+            size_t lz_enc_buf_size;
+            size_t lz_enc_file_offset;
+            size_t lz_enc_file_size;
+            size_t lz_index_interval;
+            std::shared_ptr<util::LzCheckpointIndex> lz_index;
+
+            Result LoadDecompressedData(const std::string &path);
             Result SaveCompressedData();
+            Result DeferCompressedData();
             Result ReadDecompressedData(void *read_buf, const size_t read_size, size_t &out_read_size);
             Result WriteDecompressedData(const void *write_buf, const size_t write_size);
-            Result ReallocateDecompressedData(const size_t new_size);
+            Result FillDecompressedData(const u8 value, const size_t count);
+            Result ResizeDecompressedData(const size_t new_size);
+            Result ReadBufferedData(void *read_buf, const size_t read_size, size_t &out_read_size);
+            Result SyncReadAheadWindow();
+            Result StartStreamedDecompression();
+            Result ResumeStreamedDecompression(const util::LzCheckpoint &checkpoint);
+            Result DecompressStreamedData(u8 *out_buf, const size_t size, size_t &out_size);
+            Result ReadStreamedData(void *read_buf, const size_t read_size, size_t &out_read_size);
+            void DisposeStreamedDecompression();
+
+            inline bool IsInReadAheadWindow(const size_t offset) {
+                return this->ra_window_valid && (offset >= this->ra_window_offset) && (offset <= (this->ra_window_offset + this->ra_window_size));
+            }
 
         public:
-            BinaryFile() : file_handle(), ok(false), mode(OpenMode::Read), comp(FileCompression::None), comp_lz_ver(util::LzVersion::LZ10), dec_file_data(nullptr), dec_file_offset(0), dec_file_size(0) {}
+            BinaryFile() : file_handle(), path(), ok(false), mode(OpenMode::Read), comp(FileCompression::None), comp_lz_ver(util::LzVersion::LZ10), comp_deferrable(true), comp_deferred(false), dec_file_data(), dec_file_chunks(ReallocBufferSize), dec_file_offset(0), dec_file_size(0), ra_buf(nullptr), ra_buf_size(DefaultReadAheadBufferSize), ra_window_offset(0), ra_window_size(0), ra_cur_offset(0), ra_window_valid(false), ra_hit_count(0), ra_miss_count(0), span_buf(nullptr), span_buf_size(0), dec_streaming(false), lz_dec(nullptr), lz_enc_buf(nullptr), lz_enc_buf_offset(0), lz_enc_buf_size(0), lz_enc_file_offset(0), lz_enc_file_size(0), lz_index_interval(0), lz_index() {}
             BinaryFile(const BinaryFile&) = delete;
 
             ~BinaryFile() {
@@ -43,6 +106,35 @@ namespace ntr::fs {
                 return this->comp != FileCompression::None;
             }
 
+            // Compressed files opened for reading can be decompressed lazily as they are read, only keeping the LZ window in memory (must be set before opening)
+            // Seeking backwards past that window restarts the decompression, so this is meant for sequential reads like header checks
+            // Already cached decompressed images are still used as they are
+
+            inline void SetStreamingDecompression(const bool enable) {
+                this->dec_streaming = enable;
+            }
+
+            // When streaming, decompression state checkpoints can also be saved every interval bytes of output (0 disables them, must be set before opening)
+            // Any offset can then be reached by resuming from the nearest checkpoint instead of from the start, and the checkpoints are cached for later opens of the same file
+
+            inline void SetDecompressionCheckpointInterval(const size_t interval) {
+                this->lz_index_interval = interval;
+            }
+
+            // Compressed files written by this can be kept from being deferred (see SetDeferredCompression), like files that are used right after being closed (must be set before opening)
+
+            inline void SetCompressionDeferrable(const bool deferrable) {
+                this->comp_deferrable = deferrable;
+            }
+
+            inline bool IsDecompressionStreamed() {
+                return this->lz_dec != nullptr;
+            }
+
+            inline bool HasDecompressedData() {
+                return this->IsCompressed() && this->CanRead() && !this->IsDecompressionStreamed();
+            }
+
             inline constexpr bool CanRead() {
                 return CanReadWithMode(this->mode);
             }
@@ -51,6 +143,31 @@ namespace ntr::fs {
                 return CanWriteWithMode(this->mode);
             }
 
+            // Small reads on uncompressed files are served from an in-memory window, refilled in blocks of this size (0 disables read-ahead)
+
+            inline Result SetReadAheadBufferSize(const size_t size) {
+                NTR_R_TRY(this->SyncReadAheadWindow());
+
+                if(size != this->ra_buf_size) {
+                    delete[] this->ra_buf;
+                    this->ra_buf = nullptr;
+                    this->ra_buf_size = size;
+                }
+                NTR_R_SUCCEED();
+            }
+
+            inline size_t GetReadAheadBufferSize() {
+                return this->ra_buf_size;
+            }
+
+            inline size_t GetReadAheadHitCount() {
+                return this->ra_hit_count;
+            }
+
+            inline size_t GetReadAheadMissCount() {
+                return this->ra_miss_count;
+            }
+
             inline Result GetSize(size_t &out_size) {
                 if(!this->IsValid()) {
                     NTR_R_FAIL(ResultInvalidFile);
@@ -78,6 +195,10 @@ namespace ntr::fs {
                     out_offset = this->dec_file_offset;
                     NTR_R_SUCCEED();
                 }
+                else if(this->ra_window_valid) {
+                    out_offset = this->ra_cur_offset;
+                    NTR_R_SUCCEED();
+                }
                 else {
                     return this->file_handle->GetOffset(out_offset);
                 }
@@ -95,6 +216,7 @@ namespace ntr::fs {
                 else {
                     size_t f_size;
                     NTR_R_TRY(this->GetSize(f_size));
+                    this->ra_window_valid = false;
                     return this->file_handle->SetOffset(f_size, Position::Begin);
                 }
             }
@@ -104,21 +226,40 @@ namespace ntr::fs {
                     NTR_R_FAIL(ResultInvalidFile);
                 }
 
-                if(this->IsCompressed()) {
-                    if((this->dec_file_offset + size) > this->dec_file_buf_size) {
-                        NTR_R_TRY(this->ReallocateDecompressedData(this->dec_file_offset + size));
+                if(this->IsDecompressionStreamed()) {
+                    if((this->dec_file_offset + size) > this->dec_file_size) {
+                        NTR_R_FAIL(ResultEndOfData);
                     }
                     this->dec_file_offset += size;
-                    if(this->dec_file_offset > this->dec_file_size) {
-                        this->dec_file_size = this->dec_file_offset;
+                    NTR_R_SUCCEED();
+                }
+                else if(this->IsCompressed()) {
+                    if((this->dec_file_offset + size) > this->dec_file_size) {
+                        NTR_R_TRY(this->ResizeDecompressedData(this->dec_file_offset + size));
                     }
+                    this->dec_file_offset += size;
                     NTR_R_SUCCEED();
                 }
+                else if(this->ra_window_valid) {
+                    const auto new_offset = this->ra_cur_offset + size;
+                    if(this->IsInReadAheadWindow(new_offset)) {
+                        this->ra_cur_offset = new_offset;
+                        NTR_R_SUCCEED();
+                    }
+
+                    this->ra_window_valid = false;
+                    return this->file_handle->SetOffset(new_offset, Position::Begin);
+                }
                 else {
                     return this->file_handle->SetOffset(size, Position::Current);
                 }
             }
 
+            Result GetView(const size_t offset, const size_t size, std::shared_ptr<u8> &out_view);
+
+            // Borrowing read: the returned span is only valid until the next read/write or until the file is closed (no copies are made for compressed files)
+            Result ReadSpan(const size_t size, const u8 *&out_span);
+
             Result ReadData(void *read_buf, const size_t read_size, size_t &out_read_size);
 
             inline Result ReadDataExact(void *read_buf, const size_t read_size) {
@@ -133,6 +274,13 @@ namespace ntr::fs {
                 }
             }
 
+            // Fill all the segments one after another (like ReadData, the total read size might be smaller if the end of the file is reached)
+            Result ReadV(const ReadSegment *segments, const size_t segment_count, size_t &out_read_size);
+
+            inline Result ReadV(const std::vector<ReadSegment> &segments, size_t &out_read_size) {
+                return this->ReadV(segments.data(), segments.size(), out_read_size);
+            }
+
             template<typename T>
             inline Result Read(T &out_t) {
                 return this->ReadDataExact(std::addressof(out_t), sizeof(out_t));
@@ -166,6 +314,20 @@ namespace ntr::fs {
                 if(available_size == 0) {
                     NTR_R_FAIL(ResultEndOfData);
                 }
+
+                if(this->HasDecompressedData()) {
+                    // Everything is already in memory, no need for any temporary buffers
+                    const auto str_buf = reinterpret_cast<const C*>(this->dec_file_data.get() + old_offset);
+                    const auto str_buf_len = available_size / sizeof(C);
+                    for(size_t i = 0; i < str_buf_len; i++) {
+                        if(str_buf[i] == static_cast<C>(0)) {
+                            out_str.assign(str_buf, i);
+                            this->dec_file_offset += (i + 1) * sizeof(C);
+                            NTR_R_SUCCEED();
+                        }
+                    }
+                    NTR_R_FAIL(ResultEndOfData);
+                }
                 const auto r_size = std::min(tmp_buf_size, available_size);
                 auto buf = util::NewArray<C>(r_size);
                 ScopeGuard on_exit_cleanup([&]() {
@@ -189,6 +351,16 @@ namespace ntr::fs {
 
             Result WriteData(const void *write_buf, const size_t write_size);
 
+            // Write all the segments one after another, in as few underlying writes as the file handle allows
+            Result WriteV(const WriteSegment *segments, const size_t segment_count);
+
+            inline Result WriteV(const std::vector<WriteSegment> &segments) {
+                return this->WriteV(segments.data(), segments.size());
+            }
+
+            // Write the same byte count times (padding, reserved space...) without a temporary buffer, letting the file handle optimize it
+            Result WriteFill(const u8 value, const size_t count);
+
             template<typename C>
             inline Result WriteString(const std::basic_string<C> &str) {
                 return this->WriteData(str.c_str(), str.length() * sizeof(C));
@@ -208,11 +380,7 @@ namespace ntr::fs {
                 size_t cur_offset;
                 NTR_R_TRY(this->GetAbsoluteOffset(cur_offset));
                 out_pad_size = util::AlignUp(cur_offset, align) - cur_offset;
-
-                for(size_t i = 0; i < out_pad_size; i++) {
-                    NTR_R_TRY(this->Write<u8>(0));
-                }
-                NTR_R_SUCCEED();
+                return this->WriteFill(0, out_pad_size);
             }
 
             template<typename T>
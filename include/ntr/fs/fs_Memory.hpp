@@ -0,0 +1,46 @@
+#pragma once
+#include <ntr/fs/fs_Base.hpp>
+
+namespace ntr::fs {
+
+    // Note: a single file kept contiguously in memory (paths are ignored), which grows by moving to a bigger buffer
+    // Closing it keeps the data, so formats can be written to it and read back from it (or the data taken out of it) afterwards
+    // External buffers can be adopted: shared ones are only left behind if the file outgrows them, while borrowed ones can never be outgrown
+
+    struct MemoryFileHandle : public FileHandle {
+        std::shared_ptr<u8> buf;
+        size_t buf_size;
+        size_t size;
+        size_t offset;
+        bool can_grow;
+
+        MemoryFileHandle() : buf(), buf_size(0), size(0), offset(0), can_grow(true) {}
+        MemoryFileHandle(std::shared_ptr<u8> buf, const size_t size) : buf(buf), buf_size(size), size(size), offset(0), can_grow(true) {}
+        MemoryFileHandle(u8 *ext_buf, const size_t ext_buf_size, const size_t size) : buf(ext_buf, [](u8*) {}), buf_size(ext_buf_size), size(size), offset(0), can_grow(false) {}
+
+        inline u8 *GetData() const {
+            return this->buf.get();
+        }
+
+        inline size_t GetDataSize() const {
+            return this->size;
+        }
+
+        Result Reserve(const size_t new_buf_size);
+        Result Resize(const size_t new_size);
+
+        bool Exists(const std::string &path, size_t &out_size) override;
+        Result Open(const std::string &path, const OpenMode mode) override;
+        Result GetSize(size_t &out_size) override;
+        Result SetOffset(const size_t offset, const Position pos) override;
+        Result GetOffset(size_t &out_offset) override;
+        Result Read(void *read_buf, const size_t read_size, size_t &out_read_size) override;
+        Result Write(const void *write_buf, const size_t write_size) override;
+        Result Close() override;
+
+        Result WriteV(const WriteSegment *segments, const size_t segment_count) override;
+        Result WriteFill(const u8 value, const size_t count) override;
+        Result GetView(const size_t offset, const size_t size, std::shared_ptr<u8> &out_view) override;
+    };
+
+}
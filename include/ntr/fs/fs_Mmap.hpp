@@ -0,0 +1,30 @@
+#pragma once
+#include <ntr/fs/fs_Stdio.hpp>
+
+#ifdef NTR_HOST_BUILD
+
+namespace ntr::fs {
+
+    // Note: read-only handle backed by a read-only mapping of the whole file, so views can be lent without copying (they must not be written to)
+
+    struct MmapFileHandle : public FileHandle {
+        std::shared_ptr<u8> map;
+        size_t map_size;
+        size_t offset;
+
+        MmapFileHandle() : map(), map_size(0), offset(0) {}
+
+        bool Exists(const std::string &path, size_t &out_size) override;
+        Result Open(const std::string &path, const OpenMode mode) override;
+        Result GetSize(size_t &out_size) override;
+        Result SetOffset(const size_t offset, const Position pos) override;
+        Result GetOffset(size_t &out_offset) override;
+        Result Read(void *read_buf, const size_t read_size, size_t &out_read_size) override;
+        Result Write(const void *write_buf, const size_t write_size) override;
+        Result Close() override;
+        Result GetView(const size_t offset, const size_t size, std::shared_ptr<u8> &out_view) override;
+    };
+
+}
+
+#endif
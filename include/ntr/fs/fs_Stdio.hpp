@@ -8,9 +8,47 @@ namespace ntr::fs {
     // Note: these are just wrappers for stdio stuff (the rest of this library's fs code is basically nitrofs filesystems)
 
     struct StdioFileHandle : public FileHandle {
+        enum class Access : u8 {
+            None,
+            Read,
+            Write
+        };
+
         FILE *file;
+        Access last_access;
+
+        StdioFileHandle() : file(nullptr), last_access(Access::None) {}
+
+        Result SwitchAccess(const Access access);
+
+        bool Exists(const std::string &path, size_t &out_size) override;
+        Result Open(const std::string &path, const OpenMode mode) override;
+        Result GetSize(size_t &out_size) override;
+        Result SetOffset(const size_t offset, const Position pos) override;
+        Result GetOffset(size_t &out_offset) override;
+        Result Read(void *read_buf, const size_t read_size, size_t &out_read_size) override;
+        Result Write(const void *write_buf, const size_t write_size) override;
+        Result Close() override;
+        Result ReplaceFile(const std::string &path, const std::string &new_stdio_path) override;
+
+        #ifdef NTR_HOST_BUILD
+        Result WriteFill(const u8 value, const size_t count) override;
+        bool GetNativeFileDescriptor(int &out_fd) override;
+        #endif
+    };
+
+    #ifdef NTR_HOST_BUILD
+
+    // Note: same as above, but the offset and size are tracked here and every read/write is a single pread/pwrite (no seeking at all)
+    // The cached size only accounts for writes done through this handle (or it's reloaded after lending the descriptor for a native copy)
 
-        StdioFileHandle() : file(nullptr) {}
+    struct PositionalStdioFileHandle : public FileHandle {
+        int fd;
+        size_t offset;
+        size_t size;
+        bool size_outdated;
+
+        PositionalStdioFileHandle() : fd(-1), offset(0), size(0), size_outdated(false) {}
 
         bool Exists(const std::string &path, size_t &out_size) override;
         Result Open(const std::string &path, const OpenMode mode) override;
@@ -20,8 +58,38 @@ namespace ntr::fs {
         Result Read(void *read_buf, const size_t read_size, size_t &out_read_size) override;
         Result Write(const void *write_buf, const size_t write_size) override;
         Result Close() override;
+
+        Result ReadV(const ReadSegment *segments, const size_t segment_count, size_t &out_read_size) override;
+        Result WriteV(const WriteSegment *segments, const size_t segment_count) override;
+        Result WriteFill(const u8 value, const size_t count) override;
+        Result ReplaceFile(const std::string &path, const std::string &new_stdio_path) override;
+        bool GetNativeFileDescriptor(int &out_fd) override;
+    };
+
+    // Copies data between native files inside the OS without touching the descriptors' offsets (out_copied_size might be smaller if the OS can't copy everything)
+    Result CopyNativeFileData(const int in_fd, const size_t in_offset, const int out_fd, const size_t out_offset, const size_t size, size_t &out_copied_size);
+
+    #endif
+
+    enum class CommitSyncMode : u8 {
+        // Just rename the new file over the old one
+        None,
+        // Flush the new file's data to disk before renaming it, so the old or the new file is always intact
+        File,
+        // Also flush the directory afterwards, so the rename itself survives a crash
+        FileAndDirectory
     };
 
+    // Note: syncing only happens on host builds (libfat already commits everything on close)
+    void SetCommitSyncMode(const CommitSyncMode mode);
+
+    // Atomically moves the new file over the existing one (fails if both aren't on the same filesystem, or if the platform can't rename over files)
+    Result ReplaceStdioFile(const std::string &path, const std::string &new_path);
+
+    // Replaces the file (through the handle) with an already written stdio file, renaming it over if the handle allows it, otherwise copying its data over the file
+    // Either way, the new stdio file is gone afterwards
+    Result CommitStdioFile(std::shared_ptr<FileHandle> file_handle, const std::string &path, const std::string &new_path);
+
     Result CreateStdioDirectory(const std::string &dir);
     bool IsStdioFile(const std::string &path);
     Result GetStdioFileSize(const std::string &path, size_t &out_size);
@@ -35,16 +103,46 @@ namespace ntr::fs {
         CreateStdioDirectory(base_dir);
     }
 
+    // Note: handle over a staged file's memory (paths are ignored, it always opens the same buffer)
+
+    struct ChunkedBufferFileHandle : public FileHandle {
+        std::shared_ptr<util::ChunkedBuffer> buf;
+        size_t offset;
+
+        ChunkedBufferFileHandle(std::shared_ptr<util::ChunkedBuffer> buf) : buf(buf), offset(0) {}
+
+        bool Exists(const std::string &path, size_t &out_size) override;
+        Result Open(const std::string &path, const OpenMode mode) override;
+        Result GetSize(size_t &out_size) override;
+        Result SetOffset(const size_t offset, const Position pos) override;
+        Result GetOffset(size_t &out_offset) override;
+        Result Read(void *read_buf, const size_t read_size, size_t &out_read_size) override;
+        Result Write(const void *write_buf, const size_t write_size) override;
+        Result WriteFill(const u8 value, const size_t count) override;
+        Result Close() override;
+    };
+
+    // Opens a staged file wherever it currently is
+    Result OpenExternalFsFile(const ExternalFsFile &file, const OpenMode mode, BinaryFile &out_bf);
+    // Moves a staged file from memory to its stdio path
+    Result SpillExternalFsFile(ExternalFsFile &file);
+    // Spills closed staged files (least recently used first) until the ones left in memory fit the budget
+    void SpillExternalFsFiles(ExternalFsFileFormat &ext_fs_file);
+    void DeleteExternalFsFile(const ExternalFsFile &file);
+
     template<typename T>
     struct ExternalFsFileHandle : public FileHandle {
         static_assert(std::is_base_of_v<ExternalFsFileFormat, T>);
 
         std::shared_ptr<T> ext_fs_file;
         bool rw_from_ext_fs_file;
-        std::string ext_fs_path;
+        bool ext_fs_in_memory;
+        fs::OpenMode ext_fs_mode;
+        // Path of the opened file inside the format
+        std::string base_path;
         fs::BinaryFile ext_fs_bin_file;
 
-        ExternalFsFileHandle(std::shared_ptr<T> ext_fs_file) : ext_fs_file(ext_fs_file) {
+        ExternalFsFileHandle(std::shared_ptr<T> ext_fs_file) : ext_fs_file(ext_fs_file), rw_from_ext_fs_file(false), ext_fs_in_memory(false), ext_fs_mode(fs::OpenMode::Read) {
             // TODO: check err here?
             fs::CreateStdioDirectory(ext_fs_file->ext_fs_root_path);
         }
@@ -57,19 +155,105 @@ namespace ntr::fs {
         virtual Result ReadImpl(void *read_buf, const size_t read_size, size_t &out_read_size) = 0;
         virtual Result CloseImpl() = 0;
 
+        virtual Result GetViewImpl(const size_t offset, const size_t size, std::shared_ptr<u8> &out_view) {
+            NTR_R_FAIL(ResultViewNotSupported);
+        }
+
+        virtual bool GetSubrangeImpl(const std::string &path, std::shared_ptr<FileHandle> &out_parent_handle, std::string &out_parent_path, size_t &out_offset, size_t &out_size) {
+            return false;
+        }
+
         bool Exists(const std::string &path, size_t &out_size) override {
-            return this->ExistsImpl(path, out_size);
+            const auto staged_file = this->ext_fs_file->FindExternalFsFile(path);
+            if(staged_file != nullptr) {
+                out_size = staged_file->size;
+                return true;
+            }
+            else {
+                return this->ExistsImpl(path, out_size);
+            }
+        }
+
+        Result StageCurrentData(const std::string &path, ExternalFsFile &file) {
+            NTR_R_TRY(this->OpenImpl(path));
+            ScopeGuard on_exit_close([&]() {
+                this->CloseImpl();
+            });
+
+            size_t size;
+            NTR_R_TRY(this->GetSizeImpl(size));
+
+            auto copy_buf = util::NewArray<u8>(CopyBufferSize);
+            ScopeGuard on_exit_cleanup([&]() {
+                delete[] copy_buf;
+            });
+
+            {
+                // Nothing partially copied is left behind
+                ScopeGuard on_fail_delete([&]() {
+                    DeleteExternalFsFile(file);
+                });
+
+                BinaryFile bf;
+                NTR_R_TRY(OpenExternalFsFile(file, fs::OpenMode::Write, bf));
+
+                auto cur_left_size = size;
+                while(cur_left_size > 0) {
+                    size_t read_size;
+                    NTR_R_TRY(this->ReadImpl(copy_buf, std::min(cur_left_size, CopyBufferSize), read_size));
+                    if(read_size == 0) {
+                        NTR_R_FAIL(ResultUnexpectedReadSize);
+                    }
+
+                    NTR_R_TRY(bf.WriteData(copy_buf, read_size));
+                    cur_left_size -= read_size;
+                }
+
+                NTR_R_TRY(bf.Close());
+                on_fail_delete.Cancel();
+            }
+
+            file.size = size;
+            NTR_R_SUCCEED();
         }
 
         Result Open(const std::string &path, const fs::OpenMode mode) override {
-            this->ext_fs_path = this->ext_fs_file->GetExternalFsPath(path);
-    
-            this->rw_from_ext_fs_file = fs::IsStdioFile(this->ext_fs_path) || fs::CanWriteWithMode(mode);
+            auto staged_file = this->ext_fs_file->FindExternalFsFile(path);
+            this->rw_from_ext_fs_file = (staged_file != nullptr) || fs::CanWriteWithMode(mode);
             if(this->rw_from_ext_fs_file) {
-                EnsureBaseStdioDirectoryExists(this->ext_fs_path);
-                return this->ext_fs_bin_file.Open(std::make_shared<fs::StdioFileHandle>(), this->ext_fs_path, mode);
+                if(staged_file == nullptr) {
+                    // Only files actually inside can be staged
+                    ExternalFsFile new_file = {};
+                    NTR_R_TRY(this->ext_fs_file->LocateExternalFsFile(path, new_file.file_id));
+                    new_file.ext_fs_path = this->ext_fs_file->GetExternalFsPath(path);
+                    if(this->ext_fs_file->ext_fs_mem_budget > 0) {
+                        new_file.mem_data = std::make_shared<util::ChunkedBuffer>(ExternalFsMemoryBlockSize);
+                    }
+                    else {
+                        EnsureBaseStdioDirectoryExists(new_file.ext_fs_path);
+                    }
+
+                    // Only files opened to be rewritten start empty, otherwise they start with their current data
+                    if(mode != fs::OpenMode::Write) {
+                        NTR_R_TRY(this->StageCurrentData(path, new_file));
+                    }
+
+                    NTR_R_TRY(OpenExternalFsFile(new_file, mode, this->ext_fs_bin_file));
+                    staged_file = std::addressof(this->ext_fs_file->ext_fs_files[path] = new_file);
+                }
+                else {
+                    NTR_R_TRY(OpenExternalFsFile(*staged_file, mode, this->ext_fs_bin_file));
+                }
+
+                staged_file->open_count++;
+                staged_file->last_use = this->ext_fs_file->ext_fs_use_count++;
+                this->ext_fs_in_memory = staged_file->IsInMemory();
+                this->ext_fs_mode = mode;
+                this->base_path = path;
+                NTR_R_SUCCEED();
             }
             else {
+                this->base_path = path;
                 return this->OpenImpl(path);
             }
         }
@@ -121,19 +305,122 @@ namespace ntr::fs {
             }
         }
 
+        Result SpillIfOverMemoryBudget() {
+            if(!this->ext_fs_in_memory) {
+                NTR_R_SUCCEED();
+            }
+
+            // A file too big for the whole budget can't wait to be closed to leave memory
+            size_t cur_size;
+            NTR_R_TRY(this->ext_fs_bin_file.GetSize(cur_size));
+            if(cur_size <= this->ext_fs_file->ext_fs_mem_budget) {
+                NTR_R_SUCCEED();
+            }
+
+            // Other handles still writing to the same buffer would lose their writes, so then it's left to be spilled once closed
+            auto staged_file = this->ext_fs_file->FindExternalFsFile(this->base_path);
+            if((staged_file == nullptr) || (staged_file->open_count != 1)) {
+                NTR_R_SUCCEED();
+            }
+
+            size_t cur_offset;
+            NTR_R_TRY(this->ext_fs_bin_file.GetAbsoluteOffset(cur_offset));
+            NTR_R_TRY(this->ext_fs_bin_file.Close());
+            staged_file->size = cur_size;
+            NTR_R_TRY(SpillExternalFsFile(*staged_file));
+            this->ext_fs_in_memory = false;
+
+            // Reopening it for writing would truncate it again
+            const auto reopen_mode = (this->ext_fs_mode == fs::OpenMode::Update) ? fs::OpenMode::Update : fs::OpenMode::ReadWrite;
+            NTR_R_TRY(OpenExternalFsFile(*staged_file, reopen_mode, this->ext_fs_bin_file));
+            if(reopen_mode != fs::OpenMode::Update) {
+                NTR_R_TRY(this->ext_fs_bin_file.SetAbsoluteOffset(cur_offset));
+            }
+            NTR_R_SUCCEED();
+        }
+
         Result Write(const void *write_buf, const size_t write_size) override {
             if(this->rw_from_ext_fs_file) {
-                return this->ext_fs_bin_file.WriteData(write_buf, write_size);
+                NTR_R_TRY(this->ext_fs_bin_file.WriteData(write_buf, write_size));
+                return this->SpillIfOverMemoryBudget();
+            }
+            else {
+                NTR_R_FAIL(ResultWriteNotSupported);
+            }
+        }
+
+        Result WriteV(const WriteSegment *segments, const size_t segment_count) override {
+            if(this->rw_from_ext_fs_file) {
+                NTR_R_TRY(this->ext_fs_bin_file.WriteV(segments, segment_count));
+                return this->SpillIfOverMemoryBudget();
+            }
+            else {
+                NTR_R_FAIL(ResultWriteNotSupported);
+            }
+        }
+
+        Result WriteFill(const u8 value, const size_t count) override {
+            if(this->rw_from_ext_fs_file) {
+                NTR_R_TRY(this->ext_fs_bin_file.WriteFill(value, count));
+                return this->SpillIfOverMemoryBudget();
             }
             else {
                 NTR_R_FAIL(ResultWriteNotSupported);
             }
         }
 
+        Result ReplaceFile(const std::string &path, const std::string &new_stdio_path) override {
+            // Replacing a file inside is just like writing it: it's staged until the container is saved
+            ExternalFsFile new_file = {};
+            NTR_R_TRY(this->ext_fs_file->LocateExternalFsFile(path, new_file.file_id));
+            NTR_R_TRY(GetStdioFileSize(new_stdio_path, new_file.size));
+            new_file.ext_fs_path = this->ext_fs_file->GetExternalFsPath(path);
+
+            EnsureBaseStdioDirectoryExists(new_file.ext_fs_path);
+            NTR_R_TRY(ReplaceStdioFile(new_file.ext_fs_path, new_stdio_path));
+            this->ext_fs_file->ext_fs_files[path] = new_file;
+            NTR_R_SUCCEED();
+        }
+
+        bool GetSubrange(const std::string &path, std::shared_ptr<FileHandle> &out_parent_handle, std::string &out_parent_path, size_t &out_offset, size_t &out_size) override {
+            // Staged files aren't inside the format anymore
+            if(this->ext_fs_file->FindExternalFsFile(path) != nullptr) {
+                return false;
+            }
+            else {
+                return this->GetSubrangeImpl(path, out_parent_handle, out_parent_path, out_offset, out_size);
+            }
+        }
+
+        Result GetView(const size_t offset, const size_t size, std::shared_ptr<u8> &out_view) override {
+            if(this->rw_from_ext_fs_file) {
+                return this->ext_fs_bin_file.GetView(offset, size, out_view);
+            }
+            else {
+                return this->GetViewImpl(offset, size, out_view);
+            }
+        }
+
         Result Close() override {
-            this->ext_fs_path.clear();
+            const auto path = std::move(this->base_path);
+            this->base_path.clear();
             if(this->rw_from_ext_fs_file) {
-                return this->ext_fs_bin_file.Close();
+                auto staged_file = this->ext_fs_file->FindExternalFsFile(path);
+                if(staged_file != nullptr) {
+                    if(this->ext_fs_bin_file.CanWrite()) {
+                        size_t staged_size;
+                        if(this->ext_fs_bin_file.GetSize(staged_size).IsSuccess()) {
+                            staged_file->size = staged_size;
+                        }
+                    }
+                    if(staged_file->open_count > 0) {
+                        staged_file->open_count--;
+                    }
+                }
+                NTR_R_TRY(this->ext_fs_bin_file.Close());
+
+                SpillExternalFsFiles(*this->ext_fs_file);
+                NTR_R_SUCCEED();
             }
             else {
                 return this->CloseImpl();
@@ -141,32 +428,75 @@ namespace ntr::fs {
         }
     };
 
+    // Note: walks a directory lazily (one readdir per entry), reusing the same path buffer for every entry
+    // Entry types come from d_type, only stat-ing entries when it's unknown (or a link); "." and ".." are never listed
+
     class StdioFileSystemIterator {
+        public:
+            // Entries rejected by the filter aren't listed, but rejected directories are still walked when recursive
+            using Filter = std::function<bool(const StdioFileSystemIterator&)>;
+
         private:
-            std::vector<dirent> loaded_entries;
+            struct DirectoryState {
+                DIR *dir;
+                size_t path_len;
+            };
+
+            std::vector<DirectoryState> dir_stack;
+            std::string cur_path;
+            size_t cur_name_offset;
+            bool cur_is_file;
+            bool cur_is_dir;
+            bool cur_is_link;
+            bool recursive;
+            bool skip_cur_dir;
+            Filter filter;
+
+            void PushDirectory(const size_t path_len);
+            bool LoadNextEntry();
 
         public:
-            StdioFileSystemIterator(const std::string &path) {
-                
+            StdioFileSystemIterator(const std::string &path, const bool recursive = false, Filter filter = nullptr);
+            StdioFileSystemIterator(const StdioFileSystemIterator&) = delete;
+            ~StdioFileSystemIterator();
+
+            // Moves to the next entry, returning false once everything was listed
+            bool Next();
+
+            // When recursive, don't walk into the current entry's directory
+            inline void SkipDirectory() {
+                this->skip_cur_dir = true;
+            }
+
+            inline bool IsValid() const {
+                return !this->dir_stack.empty();
+            }
+
+            // Only valid until the next call to Next()
+            inline const std::string &GetEntryPath() const {
+                return this->cur_path;
+            }
+
+            inline const char *GetEntryName() const {
+                return this->cur_path.c_str() + this->cur_name_offset;
+            }
+
+            inline bool IsFile() const {
+                return this->cur_is_file;
+            }
+
+            inline bool IsDirectory() const {
+                return this->cur_is_dir;
+            }
+
+            // 0 for entries directly inside the iterated directory
+            inline size_t GetDepth() const {
+                return this->dir_stack.size() - 1;
             }
     };
 
-    #define FS_FOR_EACH_STDIO_ENTRY(path, ...) { \
-        auto dir = opendir(path.c_str()); \
-        if(dir) { \
-            while(true) { \
-                auto ent = readdir(dir); \
-                if(ent == nullptr) { \
-                    break; \
-                } \
-                const std::string entry_name = ent->d_name; \
-                const std::string entry_path = path + "/" + entry_name; \
-                const bool is_file = ent->d_type & DT_REG; \
-                const bool is_dir = ent->d_type & DT_DIR; \
-                __VA_ARGS__ \
-            } \
-            closedir(dir); \
-        } \
+    inline bool IsStdioFileEntry(const StdioFileSystemIterator &it) {
+        return it.IsFile();
     }
 
 }
\ No newline at end of file
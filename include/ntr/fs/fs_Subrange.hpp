@@ -0,0 +1,32 @@
+#pragma once
+#include <ntr/fs/fs_Base.hpp>
+
+namespace ntr::fs {
+
+    // Note: read-only handle over a range of another file, resolved through every nesting level (see FileHandle::GetSubrange) to the outermost file when set
+    // Reads are then a seek plus a read on that file, however deeply nested the range was (paths given to Open are ignored)
+
+    struct SubrangeFileHandle : public FileHandle {
+        std::shared_ptr<FileHandle> root_handle;
+        std::string root_path;
+        size_t base_offset;
+        size_t size;
+        size_t offset;
+
+        SubrangeFileHandle() : root_handle(), root_path(), base_offset(0), size(0), offset(0) {}
+
+        void SetRange(std::shared_ptr<FileHandle> handle, const std::string &path, const size_t base_offset, const size_t size);
+
+        bool Exists(const std::string &path, size_t &out_size) override;
+        Result Open(const std::string &path, const OpenMode mode) override;
+        Result GetSize(size_t &out_size) override;
+        Result SetOffset(const size_t offset, const Position pos) override;
+        Result GetOffset(size_t &out_offset) override;
+        Result Read(void *read_buf, const size_t read_size, size_t &out_read_size) override;
+        Result Write(const void *write_buf, const size_t write_size) override;
+        Result Close() override;
+        bool GetSubrange(const std::string &path, std::shared_ptr<FileHandle> &out_parent_handle, std::string &out_parent_path, size_t &out_offset, size_t &out_size) override;
+        Result GetView(const size_t offset, const size_t size, std::shared_ptr<u8> &out_view) override;
+    };
+
+}
@@ -2,6 +2,7 @@
 #pragma once
 #include <cstdint>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <cstdio>
 #include <cstring>
@@ -15,12 +16,18 @@
 #include <climits>
 #include <cmath>
 #include <stack>
+#include <map>
 #include <optional>
 #include <iomanip>
 #include <algorithm>
 
 #define ATTR_PACKED __attribute__((packed))
 
+// Anything not built for the DS (ARM9) is considered a host build, where the full POSIX API is available
+#ifndef ARM9
+#define NTR_HOST_BUILD
+#endif
+
 namespace ntr {
 
     using u8 = uint8_t;
@@ -122,6 +129,12 @@ namespace ntr {
     constexpr Result ResultUnableToCloseStdioFile = 0x020e;
     constexpr Result ResultUnableToCreateStdioDirectory = 0x020f;
     constexpr Result ResultUnableToDeleteStdioFile = 0x0210;
+    constexpr Result ResultViewNotSupported = 0x0211;
+    constexpr Result ResultUnableToMapStdioFile = 0x0212;
+    constexpr Result ResultReplaceNotSupported = 0x0213;
+    constexpr Result ResultUnableToReplaceStdioFile = 0x0214;
+    constexpr Result ResultUnableToSyncStdioFile = 0x0215;
+    constexpr Result ResultUnableToGrowMemoryFile = 0x0216;
 
     constexpr Result ResultNitroFsDirectoryNotFound = 0x0301;
     constexpr Result ResultNitroFsFileNotFound = 0x0302;
@@ -183,6 +196,12 @@ namespace ntr {
     constexpr Result ResultCompressionInvalidLzFormat = 0x0f01;
     constexpr Result ResultCompressionTooBigCompressSize = 0x0f02;
     constexpr Result ResultCompressionInvalidRepeatSize = 0x0f03;
+    constexpr Result ResultCompressionInvalidLevel = 0x0f04;
+    constexpr Result ResultCompressionUnexpectedEndOfData = 0x0f05;
+    constexpr Result ResultCompressionOutputBufferTooSmall = 0x0f06;
+    constexpr Result ResultCompressionInvalidOutputBuffer = 0x0f07;
+    constexpr Result ResultCompressionAllocationFailure = 0x0f08;
+    constexpr Result ResultCompressionInvalidDecompressedSize = 0x0f09;
 
     constexpr Result ResultUtilityInvalidSections = 0x1001;
 
@@ -217,6 +236,12 @@ namespace ntr {
         { ResultUnableToCloseStdioFile, "Unable to close stdio file" },
         { ResultUnableToCreateStdioDirectory, "Unable to create stdio directory" },
         { ResultUnableToDeleteStdioFile, "Unable to delete stdio file" },
+        { ResultViewNotSupported, "View not supported in file" },
+        { ResultUnableToMapStdioFile, "Unable to map stdio file" },
+        { ResultReplaceNotSupported, "Replace not supported in file" },
+        { ResultUnableToReplaceStdioFile, "Unable to replace stdio file" },
+        { ResultUnableToSyncStdioFile, "Unable to sync stdio file" },
+        { ResultUnableToGrowMemoryFile, "Unable to grow memory file" },
 
         { ResultNitroFsDirectoryNotFound, "NitroFs directory not found" },
         { ResultNitroFsFileNotFound, "NitroFs file not found" },
@@ -17,17 +17,158 @@ namespace ntr::util {
     constexpr u64 MaximumLZ11CompressSize = 1ull << static_cast<u64>(4 * CHAR_BIT);
 
     constexpr u32 LZ10RepeatSize = 18;
-    constexpr u32 MaximumLZ11RepeatSize = 65809;
-    constexpr u32 DefaultRepeatSize = LZ10RepeatSize;
+    constexpr u32 MaximumLZ11RepeatSize = 0x111 + 0xFFFF;
+
+    inline constexpr u32 GetMaximumRepeatSize(const LzVersion ver) {
+        return (ver == LzVersion::LZ11) ? MaximumLZ11RepeatSize : LZ10RepeatSize;
+    }
+
+    enum class LzCompressionLevel : u8 {
+        // Takes the longest match found at each position (searching only a few candidates)
+        Fast,
+        // Like Fast, but a match is given up for a longer one starting at the next position
+        Lazy,
+        // Picks the tokens giving the smallest output (flag bits and the different LZ11 match sizes included)
+        Optimal
+    };
+
+    constexpr LzCompressionLevel DefaultLzCompressionLevel = LzCompressionLevel::Lazy;
 
     Result LzValidateCompressed(const u32 lz_header, LzVersion &out_ver);
 
-    Result LzCompress(const u8 *data, const size_t data_size, const LzVersion ver, const u32 repeat_size, u8 *&out_data, size_t &out_size);
+    Result LzCompress(const u8 *data, const size_t data_size, const LzVersion ver, const u32 repeat_size, const LzCompressionLevel level, u8 *&out_data, size_t &out_size);
 
     inline Result LzCompressDefault(const u8 *data, const size_t data_size, const LzVersion ver, u8 *&out_data, size_t &out_size) {
-        return LzCompress(data, data_size, ver, DefaultRepeatSize, out_data, out_size);
+        return LzCompress(data, data_size, ver, GetMaximumRepeatSize(ver), DefaultLzCompressionLevel, out_data, out_size);
     }
 
+    struct LzCompressJob {
+        const u8 *data;
+        size_t data_size;
+        LzVersion ver;
+        u32 repeat_size;
+        LzCompressionLevel level;
+        // Set by LzCompressBatch (out_data only if rc succeeded, to be freed by the caller)
+        u8 *out_data;
+        size_t out_size;
+        Result rc;
+    };
+
+    // Rough memory LzCompress needs besides the input itself (the worst-case temporary output plus the final one)
+    inline constexpr size_t GetLzCompressMemorySize(const size_t data_size) {
+        return 2 * (2 * sizeof(u32) + data_size + (data_size + 7) / 8 + 1);
+    }
+
+    // Compresses every job, concurrently on host builds with up to thread_count threads (0 meaning one per hardware thread)
+    // Jobs only start while the memory they need (see above) fits in mem_budget together with the running ones, but one is always allowed to run
+    // Every job is attempted, and the first failed one's result (in job order) is returned
+    Result LzCompressBatch(LzCompressJob *jobs, const size_t job_count, const size_t thread_count, const size_t mem_budget);
+
+    // Reads the next bytes to compress (at most read_size, but at least one), or takes the next piece of compressed output
+    using LzReadFunction = std::function<Result(u8 *read_buf, const size_t read_size, size_t &out_read_size)>;
+    using LzWriteFunction = std::function<Result(const u8 *write_buf, const size_t write_size)>;
+
+    // Matches are kept this short when streaming, so that little input needs to be kept ahead (long LZ11 matches are split, barely growing the output)
+    constexpr size_t LzStreamMaximumMatchSize = 0x1000;
+
+    // Same as LzCompress, but reading the data_size bytes to compress and writing the output in pieces, only keeping the window and a small lookahead in memory
+    Result LzCompressStream(const size_t data_size, const LzVersion ver, const u32 repeat_size, const LzCompressionLevel level, const LzReadFunction &read_fn, const LzWriteFunction &write_fn, size_t &out_size);
+
+    // Even if every token was the longest back-reference (flag bytes aside), data_size bytes of compressed data can't decompress to more than this
+    inline constexpr size_t GetLzMaximumDecompressedSize(const LzVersion ver, const size_t data_size) {
+        const size_t max_token_ratio = (ver == LzVersion::LZ11) ? ((MaximumLZ11RepeatSize + 3) / 4) : ((LZ10RepeatSize + 1) / 2);
+        return (data_size > (SIZE_MAX / max_token_ratio)) ? SIZE_MAX : (data_size * max_token_ratio);
+    }
+
+    // Needs the first 8 bytes of the compressed data (or all of it if it's smaller)
+    Result LzReadHeader(const u8 *data, const size_t data_size, LzVersion &out_ver, size_t &out_dec_size, size_t &out_header_size);
+
+    // Trusts the compressed data: only use it for data known to be valid
     Result LzDecompress(const u8 *data, u8 *&out_data, size_t &out_size, LzVersion &out_ver, size_t &out_used_data_size);
 
+    // Never reads past data_size or writes past out_data_size, failing on truncated or invalid data instead (the output buffer must fit the decompressed size in the header)
+    Result LzDecompress(const u8 *data, const size_t data_size, u8 *out_data, const size_t out_data_size, LzVersion &out_ver, size_t &out_dec_size, size_t &out_used_data_size);
+
+    // Incremental decompression: compressed data is fed in pieces, and only the last window of decompressed data (what back-references can reach) is kept
+    // The whole state is plain data, so copies of it can be saved and resumed later
+
+    class LzDecompressor {
+        public:
+            static constexpr size_t WindowSize = 0x1000;
+            // Control byte + longest (LZ11) back-reference
+            static constexpr size_t MaximumTokenSize = 1 + 4;
+
+        private:
+            LzVersion ver;
+            size_t dec_size;
+            size_t dec_offset;
+            u8 window[WindowSize];
+            u8 cur_flags;
+            u8 cur_flags_left;
+            size_t copy_left_size;
+            size_t copy_disp;
+
+        public:
+            LzDecompressor() : ver(LzVersion::Invalid), dec_size(0), dec_offset(0), window(), cur_flags(0), cur_flags_left(0), copy_left_size(0), copy_disp(0) {}
+
+            // Needs the first 8 bytes of the compressed data (or all of it if it's smaller)
+            Result Initialize(const u8 *enc_data, const size_t enc_data_size, size_t &out_header_size);
+
+            // Stops once the output buffer is full, the decompression is finished or more compressed data is needed to continue
+            // Compressed data that wasn't used (out_used_enc_size onwards) must be fed again in the next call
+            Result Decompress(const u8 *enc_data, const size_t enc_data_size, size_t &out_used_enc_size, u8 *out_data, const size_t out_data_size, size_t &out_dec_size);
+
+            // Only the last WindowSize decompressed bytes can be copied this way
+            Result CopyFromWindow(const size_t dec_offset, u8 *out_data, const size_t out_data_size);
+
+            inline LzVersion GetVersion() const {
+                return this->ver;
+            }
+
+            inline size_t GetDecompressedSize() const {
+                return this->dec_size;
+            }
+
+            inline size_t GetDecompressedOffset() const {
+                return this->dec_offset;
+            }
+
+            inline bool IsFinished() const {
+                return this->dec_offset == this->dec_size;
+            }
+
+            inline bool IsInWindow(const size_t dec_offset) const {
+                return (dec_offset <= this->dec_offset) && ((this->dec_offset - dec_offset) <= WindowSize);
+            }
+    };
+
+    // Decompression can be resumed from any of these (enc_offset being where to continue feeding compressed data from)
+
+    struct LzCheckpoint {
+        size_t enc_offset;
+        LzDecompressor dec;
+    };
+
+    struct LzCheckpointIndex {
+        size_t interval;
+        // The checkpoint at index i is located at decompressed offset (i + 1) * interval
+        std::vector<LzCheckpoint> checkpoints;
+
+        LzCheckpointIndex(const size_t interval) : interval(interval), checkpoints() {}
+
+        inline size_t GetNextCheckpointOffset() const {
+            return (this->checkpoints.size() + 1) * this->interval;
+        }
+
+        inline const LzCheckpoint *FindNearest(const size_t dec_offset) const {
+            const auto checkpoint_count = std::min(dec_offset / this->interval, this->checkpoints.size());
+            if(checkpoint_count == 0) {
+                return nullptr;
+            }
+            else {
+                return std::addressof(this->checkpoints[checkpoint_count - 1]);
+            }
+        }
+    };
+
 }
\ No newline at end of file
@@ -20,4 +20,40 @@ namespace ntr::util {
 		return (value % align) == 0;
 	}
 
-}
\ No newline at end of file
+    // Growable buffer made of fixed-size blocks: growing it never moves (or copies) existing data, and it's only made contiguous when requested
+
+    class ChunkedBuffer {
+        public:
+            static constexpr size_t DefaultBlockSize = 0x10000;
+
+        private:
+            size_t block_size;
+            std::vector<u8*> blocks;
+            size_t size;
+
+        public:
+            ChunkedBuffer(const size_t block_size = DefaultBlockSize) : block_size(block_size), blocks(), size(0) {}
+            ChunkedBuffer(const ChunkedBuffer&) = delete;
+
+            ~ChunkedBuffer() {
+                this->Clear();
+            }
+
+            void Clear();
+
+            // New space is zero-filled
+            void Resize(const size_t new_size);
+
+            void Write(const size_t offset, const void *data, const size_t data_size);
+            void Fill(const size_t offset, const u8 value, const size_t fill_size);
+            Result Read(const size_t offset, void *out_data, const size_t data_size) const;
+
+            // Copies all the data contiguously (out_data must fit GetSize() bytes)
+            void CopyTo(u8 *out_data) const;
+
+            inline size_t GetSize() const {
+                return this->size;
+            }
+    };
+
+}
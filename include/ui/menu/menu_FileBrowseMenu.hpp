@@ -38,6 +38,11 @@ namespace ui::menu {
                 NTR_R_TRY(file.WriteTo(path, std::make_shared<ntr::fs::StdioFileHandle>()));
             }
             else {
+                // Files edited inside a container are only compressed when it's saved, all of them together
+                ntr::fs::SetDeferredCompression(true);
+                ntr::ScopeGuard on_exit_cleanup([&]() {
+                    ntr::fs::SetDeferredCompression(false);
+                });
                 NTR_R_TRY(file.WriteTo(CreateCurrentFileHandle()));
             }
             NTR_R_SUCCEED();
@@ -86,6 +86,7 @@ namespace ntr::fmt {
 
     Result BMG::ValidateImpl(const std::string &path, std::shared_ptr<fs::FileHandle> file_handle, const fs::FileCompression comp) {
         fs::BinaryFile bf = {};
+        bf.SetStreamingDecompression(true);
         NTR_R_TRY(bf.Open(file_handle, path, fs::OpenMode::Read, comp));
 
         NTR_R_TRY(bf.Read(this->header));
@@ -147,12 +148,9 @@ namespace ntr::fmt {
             NTR_R_TRY(bf.Read(offset));
 
             Message msg = {};
-            for(u32 j = 0; j < attrs_size; j++) {
-                u8 attr;
-                NTR_R_TRY(bf.Read(attr));
-
-                msg.attrs.push_back(attr);
-            }
+            const u8 *attrs;
+            NTR_R_TRY(bf.ReadSpan(attrs_size, attrs));
+            msg.attrs.assign(attrs, attrs + attrs_size);
 
             size_t old_offset;
             NTR_R_TRY(bf.GetAbsoluteOffset(old_offset));
@@ -183,13 +181,9 @@ namespace ntr::fmt {
                     escape_size -= GetCharacterSize(this->header.encoding);
                     escape_size -= sizeof(u8);
 
-                    cur_token.escape.esc_data.reserve(escape_size);
-                    for(u32 i = 0; i < escape_size; i++) {
-                        u8 escape_byte;
-                        NTR_R_TRY(bf.Read(escape_byte));
-
-                        cur_token.escape.esc_data.push_back(escape_byte);
-                    }
+                    const u8 *esc_data;
+                    NTR_R_TRY(bf.ReadSpan(escape_size, esc_data));
+                    cur_token.escape.esc_data.assign(esc_data, esc_data + escape_size);
 
                     msg.msg.push_back(cur_token);
                     cur_token = {};
@@ -273,8 +267,11 @@ namespace ntr::fmt {
             const auto cur_msg = this->messages.at(i);
 
             NTR_R_TRY(bf.SetAbsoluteOffset(entries_offset + i * this->info.entry_size));
-            NTR_R_TRY(bf.Write(cur_message_rel_offset));
-            NTR_R_TRY(bf.WriteVector(cur_msg.attrs));
+            const fs::WriteSegment entry_segments[] = {
+                { std::addressof(cur_message_rel_offset), sizeof(cur_message_rel_offset) },
+                { cur_msg.attrs.data(), cur_msg.attrs.size() }
+            };
+            NTR_R_TRY(bf.WriteV(entry_segments, std::size(entry_segments)));
 
             NTR_R_TRY(bf.SetAbsoluteOffset(messages_offset + cur_message_rel_offset));
             for(const auto &token: cur_msg.msg) {
@@ -312,9 +309,12 @@ namespace ntr::fmt {
             const auto ids_offset = msg_id_offset + sizeof(MessageIdSection);
 
             NTR_R_TRY(bf.SetAbsoluteOffset(ids_offset));
+            std::vector<fs::WriteSegment> id_segments;
+            id_segments.reserve(this->messages.size());
             for(const auto &msg: this->messages) {
-                NTR_R_TRY(bf.Write(msg.id));
+                id_segments.push_back({ std::addressof(msg.id), sizeof(msg.id) });
             }
+            NTR_R_TRY(bf.WriteV(id_segments));
 
             size_t msg_id_pad_size;
             NTR_R_TRY(bf.WriteEnsureAlignment(DataAlignment, msg_id_pad_size));
@@ -4,6 +4,7 @@ namespace ntr::fmt {
 
     Result NARC::ValidateImpl(const std::string &path, std::shared_ptr<fs::FileHandle> file_handle, const fs::FileCompression comp) {
         fs::BinaryFile bf = {};
+        bf.SetStreamingDecompression(true);
         NTR_R_TRY(bf.Open(file_handle, path, fs::OpenMode::Read, comp));
 
         NTR_R_TRY(bf.Read(this->header));
@@ -4,6 +4,7 @@ namespace ntr::fmt {
 
     Result NSCR::ValidateImpl(const std::string &path, std::shared_ptr<fs::FileHandle> file_handle, const fs::FileCompression comp) {
         fs::BinaryFile bf;
+        bf.SetStreamingDecompression(true);
         NTR_R_TRY(bf.Open(file_handle, path, fs::OpenMode::Read, comp));
 
         NTR_R_TRY(bf.Read(this->header));
@@ -23,10 +24,17 @@ namespace ntr::fmt {
         fs::BinaryFile bf;
         NTR_R_TRY(bf.Open(file_handle, path, fs::OpenMode::Read, comp));
 
-        NTR_R_TRY(bf.SetAbsoluteOffset(sizeof(Header) + sizeof(ScreenDataBlock)));
+        this->DisposeData();
+        const auto data_offset = sizeof(Header) + sizeof(ScreenDataBlock);
+        if(bf.GetView(data_offset, this->screen_data.data_size, this->data_view).IsSuccess()) {
+            this->data = this->data_view.get();
+            NTR_R_SUCCEED();
+        }
+
+        NTR_R_TRY(bf.SetAbsoluteOffset(data_offset));
         this->data = util::NewArray<u8>(this->screen_data.data_size);
         ScopeGuard on_fail_cleanup([&]() {
-            delete[] this->data;
+            this->DisposeData();
         });
 
         NTR_R_TRY(bf.ReadDataExact(this->data, this->screen_data.data_size));
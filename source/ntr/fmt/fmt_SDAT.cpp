@@ -9,50 +9,50 @@ namespace ntr::fmt {
 
         constexpr size_t DataAlignment = 0x20;
 
-        Result ReadSymbolRecord(fs::BinaryFile &bf, const size_t symb_offset, SDAT::SymbolRecord &out_record) {
-            NTR_R_TRY(bf.Read(out_record.entry_count));
+        Result ReadSymbolRecord(const StringTable &symb_table, const size_t record_offset, SDAT::SymbolRecord &out_record) {
+            if(!symb_table.Get(record_offset, out_record.entry_count)) {
+                NTR_R_FAIL(ResultSDATInvalidSymbols);
+            }
 
             out_record.entries.reserve(out_record.entry_count);
             for(u32 i = 0; i < out_record.entry_count; i++) {
                 SDAT::SymbolRecordEntry entry = {};
-                NTR_R_TRY(bf.Read(entry.name_offset));
+                if(!symb_table.Get(record_offset + sizeof(u32) + i * sizeof(u32), entry.name_offset)) {
+                    NTR_R_FAIL(ResultSDATInvalidSymbols);
+                }
 
                 if(entry.name_offset != 0) {
-                    size_t old_offset;
-                    NTR_R_TRY(bf.GetAbsoluteOffset(old_offset));
-                    NTR_R_TRY(bf.SetAbsoluteOffset(symb_offset + entry.name_offset));
-                    NTR_R_TRY(bf.ReadNullTerminatedString(entry.name));
-                    NTR_R_TRY(bf.SetAbsoluteOffset(old_offset));
+                    if(!symb_table.GetString(entry.name_offset, entry.name)) {
+                        NTR_R_FAIL(ResultSDATInvalidSymbols);
+                    }
                 }
 
-                out_record.entries.push_back(std::move(entry));
+                out_record.entries.push_back(entry);
             }
 
             NTR_R_SUCCEED();
         }
 
-        Result ReadSequenceArchiveSymbolRecord(fs::BinaryFile &bf, const size_t symb_offset, SDAT::SequenceArchiveSymbolRecord &out_seq_arc_record) {
-            NTR_R_TRY(bf.Read(out_seq_arc_record.entry_count));
+        Result ReadSequenceArchiveSymbolRecord(const StringTable &symb_table, const size_t record_offset, SDAT::SequenceArchiveSymbolRecord &out_seq_arc_record) {
+            if(!symb_table.Get(record_offset, out_seq_arc_record.entry_count)) {
+                NTR_R_FAIL(ResultSDATInvalidSymbols);
+            }
 
             out_seq_arc_record.entries.reserve(out_seq_arc_record.entry_count);
             for(u32 i = 0; i < out_seq_arc_record.entry_count; i++) {
                 SDAT::SequenceArchiveSymbolRecordEntry entry = {};
-                NTR_R_TRY(bf.Read(entry.name_offset));
-                NTR_R_TRY(bf.Read(entry.subrecord_offset));
+                const auto entry_offset = record_offset + sizeof(u32) + i * 2 * sizeof(u32);
+                if(!symb_table.Get(entry_offset, entry.name_offset) || !symb_table.Get(entry_offset + sizeof(u32), entry.subrecord_offset)) {
+                    NTR_R_FAIL(ResultSDATInvalidSymbols);
+                }
 
                 if(entry.name_offset != 0) {
-                    size_t old_offset;
-                    NTR_R_TRY(bf.GetAbsoluteOffset(old_offset));
-                    NTR_R_TRY(bf.SetAbsoluteOffset(symb_offset + entry.name_offset));
-                    NTR_R_TRY(bf.ReadNullTerminatedString(entry.name));
-                    NTR_R_TRY(bf.SetAbsoluteOffset(old_offset));
+                    if(!symb_table.GetString(entry.name_offset, entry.name)) {
+                        NTR_R_FAIL(ResultSDATInvalidSymbols);
+                    }
                 }
                 if(entry.subrecord_offset != 0) {
-                    size_t old_offset;
-                    NTR_R_TRY(bf.GetAbsoluteOffset(old_offset));
-                    NTR_R_TRY(bf.SetAbsoluteOffset(symb_offset + entry.subrecord_offset));
-                    NTR_R_TRY(ReadSymbolRecord(bf, symb_offset, entry.subrecord));
-                    NTR_R_TRY(bf.SetAbsoluteOffset(old_offset));
+                    NTR_R_TRY(ReadSymbolRecord(symb_table, entry.subrecord_offset, entry.subrecord));
                 }
 
                 out_seq_arc_record.entries.push_back(std::move(entry));
@@ -140,6 +140,7 @@ namespace ntr::fmt {
 
     Result SDAT::ValidateImpl(const std::string &path, std::shared_ptr<fs::FileHandle> file_handle, const fs::FileCompression comp) {
         fs::BinaryFile bf = {};
+        bf.SetStreamingDecompression(true);
         NTR_R_TRY(bf.Open(file_handle, path, fs::OpenMode::Read, comp));
 
         NTR_R_TRY(bf.Read(this->header));
@@ -181,29 +182,17 @@ namespace ntr::fmt {
         NTR_R_TRY(bf.Open(file_handle, path, fs::OpenMode::Read, comp));
 
         if(this->header.symb_size > 0) {
-            NTR_R_TRY(bf.SetAbsoluteOffset(this->header.symb_offset + this->symb.seq_record_offset));
-            NTR_R_TRY(ReadSymbolRecord(bf, this->header.symb_offset, this->seq_symb_record));
-
-            NTR_R_TRY(bf.SetAbsoluteOffset(this->header.symb_offset + this->symb.seq_arc_record_offset));
-            NTR_R_TRY(ReadSequenceArchiveSymbolRecord(bf, this->header.symb_offset, this->seq_arc_symb_record));
-
-            NTR_R_TRY(bf.SetAbsoluteOffset(this->header.symb_offset + this->symb.bnk_record_offset));
-            NTR_R_TRY(ReadSymbolRecord(bf, this->header.symb_offset, this->bnk_symb_record));
-
-            NTR_R_TRY(bf.SetAbsoluteOffset(this->header.symb_offset + this->symb.wav_arc_record_offset));
-            NTR_R_TRY(ReadSymbolRecord(bf, this->header.symb_offset, this->wav_arc_symb_record));
-
-            NTR_R_TRY(bf.SetAbsoluteOffset(this->header.symb_offset + this->symb.player_record_offset));
-            NTR_R_TRY(ReadSymbolRecord(bf, this->header.symb_offset, this->player_symb_record));
-
-            NTR_R_TRY(bf.SetAbsoluteOffset(this->header.symb_offset + this->symb.group_record_offset));
-            NTR_R_TRY(ReadSymbolRecord(bf, this->header.symb_offset, this->group_symb_record));
-
-            NTR_R_TRY(bf.SetAbsoluteOffset(this->header.symb_offset + this->symb.strm_player_record_offset));
-            NTR_R_TRY(ReadSymbolRecord(bf, this->header.symb_offset, this->strm_player_symb_record));
-
-            NTR_R_TRY(bf.SetAbsoluteOffset(this->header.symb_offset + this->symb.strm_record_offset));
-            NTR_R_TRY(ReadSymbolRecord(bf, this->header.symb_offset, this->strm_symb_record));
+            // All the symbol records and names are parsed from memory
+            NTR_R_TRY(this->symb_table.ReadFrom(bf, this->header.symb_offset, this->header.symb_size));
+
+            NTR_R_TRY(ReadSymbolRecord(this->symb_table, this->symb.seq_record_offset, this->seq_symb_record));
+            NTR_R_TRY(ReadSequenceArchiveSymbolRecord(this->symb_table, this->symb.seq_arc_record_offset, this->seq_arc_symb_record));
+            NTR_R_TRY(ReadSymbolRecord(this->symb_table, this->symb.bnk_record_offset, this->bnk_symb_record));
+            NTR_R_TRY(ReadSymbolRecord(this->symb_table, this->symb.wav_arc_record_offset, this->wav_arc_symb_record));
+            NTR_R_TRY(ReadSymbolRecord(this->symb_table, this->symb.player_record_offset, this->player_symb_record));
+            NTR_R_TRY(ReadSymbolRecord(this->symb_table, this->symb.group_record_offset, this->group_symb_record));
+            NTR_R_TRY(ReadSymbolRecord(this->symb_table, this->symb.strm_player_record_offset, this->strm_player_symb_record));
+            NTR_R_TRY(ReadSymbolRecord(this->symb_table, this->symb.strm_record_offset, this->strm_symb_record));
         }
 
         NTR_R_TRY(bf.SetAbsoluteOffset(this->header.info_offset + this->info.seq_record_offset));
@@ -241,20 +230,81 @@ namespace ntr::fmt {
         NTR_R_SUCCEED();
     }
 
-    Result SDAT::SaveFileSystem() {
-        std::vector<std::string> ext_fs_files;
-        NTR_R_TRY(fs::ListAllStdioFiles(this->ext_fs_root_path, ext_fs_files));
+    Result SDAT::SaveFileSystemInPlace(const std::vector<fs::ExternalFsFile> &ext_fs_files, bool &out_saved) {
+        out_saved = false;
 
-        if(!ext_fs_files.empty()) {
-            std::vector<std::pair<std::string, FileAllocationTableRecord>> files;
-            for(const auto &ext_fs_file : ext_fs_files) {
-                const auto base_path = this->GetBasePath(ext_fs_file);
-                u32 file_id;
-                NTR_R_TRY(this->LocateFile(base_path, file_id));
-                files.push_back(std::make_pair(ext_fs_file, this->fat_records[file_id]));
+        // Compressed files need to be recompressed entirely anyway
+        if(this->comp != fs::FileCompression::None) {
+            NTR_R_SUCCEED();
+        }
+
+        fs::BinaryFile bf;
+        if(bf.Open(this->read_file_handle, this->read_path, fs::OpenMode::ReadWrite).IsFailure()) {
+            // The file can't be overwritten through this handle, so it will be rewritten instead
+            NTR_R_SUCCEED();
+        }
+
+        size_t self_size;
+        NTR_R_TRY(bf.GetSize(self_size));
+
+        // Check that every file fits first, so that nothing is touched if any of them doesn't
+        for(const auto &ext_fs_file : ext_fs_files) {
+            const auto &record = this->fat_records[ext_fs_file.file_id];
+            const auto file_end_offset = record.offset + record.size;
+            auto slot_end_offset = std::min<size_t>(util::AlignUp(file_end_offset, DataAlignment), self_size);
+            for(const auto &other_record : this->fat_records) {
+                if(other_record.offset > record.offset) {
+                    slot_end_offset = std::min<size_t>(slot_end_offset, other_record.offset);
+                }
+            }
+
+            if((record.offset + ext_fs_file.size) > std::max<size_t>(slot_end_offset, file_end_offset)) {
+                NTR_R_SUCCEED();
             }
+        }
+
+        const auto fat_entries_offset = this->header.fat_offset + sizeof(FileAllocationTableBlock);
+        for(const auto &ext_fs_file : ext_fs_files) {
+            const auto new_file_size = ext_fs_file.size;
+            auto &record = this->fat_records[ext_fs_file.file_id];
+            {
+                fs::BinaryFile d_bf;
+                NTR_R_TRY(fs::OpenExternalFsFile(ext_fs_file, fs::OpenMode::Read, d_bf));
+                NTR_R_TRY(bf.SetAbsoluteOffset(record.offset));
+                NTR_R_TRY(bf.CopyFrom(d_bf, new_file_size));
+            }
+
+            // Don't leave stale data of the old file behind
+            if(new_file_size < record.size) {
+                NTR_R_TRY(bf.WriteFill(0, record.size - new_file_size));
+            }
+
+            record.size = new_file_size;
+            NTR_R_TRY(bf.SetAbsoluteOffset(fat_entries_offset + ext_fs_file.file_id * sizeof(FileAllocationTableRecord)));
+            NTR_R_TRY(bf.Write(record));
+        }
+
+        out_saved = true;
+        NTR_R_SUCCEED();
+    }
+
+    Result SDAT::SaveFileSystem() {
+        // Staged files still waiting to be compressed are all compressed (in parallel) now, before the layout is computed from their sizes
+        NTR_R_TRY(fs::FlushDeferredCompression());
+
+        // Staged files already know their IDs, so no need to scan the external fs or locate them again
+        std::vector<fs::ExternalFsFile> ext_fs_files;
+        std::vector<std::pair<fs::ExternalFsFile, FileAllocationTableRecord>> files;
+        ext_fs_files.reserve(this->ext_fs_files.size());
+        files.reserve(this->ext_fs_files.size());
+        for(const auto &[path, ext_fs_file] : this->ext_fs_files) {
+            ext_fs_files.push_back(ext_fs_file);
+            files.push_back(std::make_pair(ext_fs_file, this->fat_records[ext_fs_file.file_id]));
+        }
 
-            std::sort(files.begin(), files.end(), [](const std::pair<std::string, FileAllocationTableRecord> &p_a, const std::pair<std::string, FileAllocationTableRecord> &p_b) -> bool {
+        if(!files.empty()) {
+
+            std::sort(files.begin(), files.end(), [](const std::pair<fs::ExternalFsFile, FileAllocationTableRecord> &p_a, const std::pair<fs::ExternalFsFile, FileAllocationTableRecord> &p_b) -> bool {
                 return p_a.second.offset < p_b.second.offset;
             });
 
@@ -263,12 +313,24 @@ namespace ntr::fmt {
 
             const auto write_on_self = (w_file_handle == nullptr) || w_path.empty();
             if(write_on_self) {
+                bool saved_in_place;
+                NTR_R_TRY(this->SaveFileSystemInPlace(ext_fs_files, saved_in_place));
+                if(saved_in_place) {
+                    for(const auto &ext_fs_file : ext_fs_files) {
+                        fs::DeleteExternalFsFile(ext_fs_file);
+                    }
+                    this->ext_fs_files.clear();
+                    NTR_R_SUCCEED();
+                }
+
                 w_file_handle = std::make_shared<fs::StdioFileHandle>();
                 w_path = this->ext_fs_root_path + "_tmp_" + fs::GetFileName(this->read_path);
             }
 
             {
                 fs::BinaryFile w_bf;
+                // The new container is used right after being written, so it can't wait to be compressed
+                w_bf.SetCompressionDeferrable(false);
                 NTR_R_TRY(w_bf.Open(w_file_handle, w_path, fs::OpenMode::Write, this->comp));
 
                 fs::BinaryFile r_bf;
@@ -289,61 +351,41 @@ namespace ntr::fmt {
 
                 u32 i = 0;
                 for(auto &[ext_fs_file, file_record] : files) {
-                    size_t new_file_size;
-                    NTR_R_TRY(fs::GetStdioFileSize(ext_fs_file, new_file_size));
+                    const auto new_file_size = ext_fs_file.size;
                     {
                         fs::BinaryFile d_bf;
-                        NTR_R_TRY(d_bf.Open(std::make_shared<fs::StdioFileHandle>(), ext_fs_file, fs::OpenMode::Read));
+                        NTR_R_TRY(fs::OpenExternalFsFile(ext_fs_file, fs::OpenMode::Read, d_bf));
                         NTR_R_TRY(w_bf.CopyFrom(d_bf, new_file_size));
                     }
 
-                    size_t pad_size;
+                    size_t pad_size = 0;
                     NTR_R_TRY(w_bf.WriteEnsureAlignment(DataAlignment, pad_size));
 
                     const auto has_next_file = (i + 1) < file_count;
                     if(has_next_file) {
                         const auto &[next_ext_fs_file, next_file_record] = files[i + 1];
                         const auto data_between_files_offset = file_record.offset + file_record.size;
-                        auto data_between_files_size = next_file_record.offset - file_record.offset - file_record.size;
-        
-                        size_t w_bf_abs_offset;
-                        NTR_R_TRY(w_bf.GetAbsoluteOffset(w_bf_abs_offset));
-                        auto tmp_align_offset = w_bf_abs_offset + data_between_files_size;
-                        auto data_between_files_pad_size = 0;
-                        while(!util::IsAlignedTo(tmp_align_offset, DataAlignment)) {
-                            tmp_align_offset++;
-                            data_between_files_pad_size++;
-                        }
-                        data_between_files_size += data_between_files_pad_size;
-                        
+                        const auto data_between_files_size = next_file_record.offset - file_record.offset - file_record.size;
                         NTR_R_TRY(r_bf.SetAbsoluteOffset(data_between_files_offset));
                         NTR_R_TRY(w_bf.CopyFrom(r_bf, data_between_files_size));
+
+                        size_t data_between_files_pad_size;
+                        NTR_R_TRY(w_bf.WriteEnsureAlignment(DataAlignment, data_between_files_pad_size));
                     }
 
                     const ssize_t cur_size_diff = new_file_size + pad_size - file_record.size;
 
-                    size_t old_offset;
-                    NTR_R_TRY(w_bf.GetAbsoluteOffset(old_offset));
                     for(size_t i = 0; i < fat_entry_count; i++) {
                         auto &fat_record = this->fat_records[i];
-                        const auto cur_entry_offset = fat_entries_offset + i * sizeof(FileAllocationTableRecord);
-                        NTR_R_TRY(r_bf.SetAbsoluteOffset(cur_entry_offset));
-                        NTR_R_TRY(w_bf.SetAbsoluteOffset(cur_entry_offset));
-                        
                         if(fat_record.offset > file_record.offset) {
                             // It's a file after our current file, advance cur_size_diff the file position
                             fat_record.offset += cur_size_diff;
-
-                            NTR_R_TRY(w_bf.Write(fat_record));
                         }
                         else if(fat_record.offset == file_record.offset) {
                             // It's our current file, set the new size
                             fat_record.size = new_file_size;
-
-                            NTR_R_TRY(w_bf.Write(fat_record));
                         }
                     }
-                    NTR_R_TRY(w_bf.SetAbsoluteOffset(old_offset));
 
                     for(auto &[_ext_fs_file_2, file_record_2] : files) {
                         if(file_record_2.offset > file_record.offset) {
@@ -362,6 +404,10 @@ namespace ntr::fmt {
 
                 NTR_R_TRY(w_bf.CopyFrom(r_bf, post_file_data_size));
 
+                // The FAT is only written once, after all the records have been updated
+                NTR_R_TRY(w_bf.SetAbsoluteOffset(fat_entries_offset));
+                NTR_R_TRY(w_bf.WriteVector(this->fat_records));
+
                 this->header.file_size += size_diff;
                 this->file.block_size += size_diff;
                 NTR_R_TRY(w_bf.SetAbsoluteOffset(0));
@@ -371,25 +417,16 @@ namespace ntr::fmt {
             }
 
             if(write_on_self) {
-                fs::BinaryFile w_bf;
-                NTR_R_TRY(w_bf.Open(read_file_handle, read_path, fs::OpenMode::Write));
-
-                fs::BinaryFile r_bf;
-                NTR_R_TRY(r_bf.Open(w_file_handle, w_path, fs::OpenMode::Read));
-
-                size_t r_file_size;
-                NTR_R_TRY(r_bf.GetSize(r_file_size));
-                NTR_R_TRY(w_bf.CopyFrom(r_bf, r_file_size));
-
-                NTR_R_TRY(fs::DeleteStdioFile(w_path));
+                NTR_R_TRY(fs::CommitStdioFile(this->read_file_handle, this->read_path, w_path));
 
                 w_file_handle = nullptr;
                 w_path.clear();
             }
 
             for(const auto &ext_fs_file : ext_fs_files) {
-                fs::DeleteStdioFile(ext_fs_file);
+                fs::DeleteExternalFsFile(ext_fs_file);
             }
+            this->ext_fs_files.clear();
         }
 
         NTR_R_SUCCEED();
@@ -406,15 +443,29 @@ namespace ntr::fmt {
         }
     }
 
+    bool SDATFileHandle::GetSubrangeImpl(const std::string &path, std::shared_ptr<fs::FileHandle> &out_parent_handle, std::string &out_parent_path, size_t &out_offset, size_t &out_size) {
+        if(this->ext_fs_file->comp != fs::FileCompression::None) {
+            return false;
+        }
+
+        u32 file_id;
+        if(this->ext_fs_file->LocateFile(path, file_id).IsFailure()) {
+            return false;
+        }
+
+        const auto &record = this->ext_fs_file->fat_records[file_id];
+        out_parent_handle = this->ext_fs_file->read_file_handle;
+        out_parent_path = this->ext_fs_file->read_path;
+        out_offset = record.offset;
+        out_size = record.size;
+        return true;
+    }
+
     Result SDATFileHandle::OpenImpl(const std::string &path) {
         NTR_R_TRY(this->ext_fs_file->LocateFile(path, this->file_id));
-        
-        NTR_R_TRY(this->base_bf.Open(this->ext_fs_file->read_file_handle, this->ext_fs_file->read_path, fs::OpenMode::Read));
-
-        const auto f_base_offset = this->GetFileOffset();
-        NTR_R_TRY(this->base_bf.SetAbsoluteOffset(f_base_offset));
 
-        NTR_R_SUCCEED();
+        this->subrange.SetRange(this->ext_fs_file->read_file_handle, this->ext_fs_file->read_path, this->GetFileOffset(), this->GetFileSize());
+        return this->subrange.Open(path, fs::OpenMode::Read);
     }
 
     Result SDATFileHandle::GetSizeImpl(size_t &out_size) {
@@ -423,66 +474,23 @@ namespace ntr::fmt {
     }
 
     Result SDATFileHandle::SetOffsetImpl(const size_t offset, const fs::Position pos) {
-        size_t f_size;
-        NTR_R_TRY(this->GetSize(f_size));
-
-        const auto f_base_offset = this->GetFileOffset();
-        size_t f_cur_offset;
-        NTR_R_TRY(this->base_bf.GetAbsoluteOffset(f_cur_offset));
-
-        switch(pos) {
-            case fs::Position::Begin: {
-                if(offset > f_size) {
-                    NTR_R_FAIL(ResultEndOfData);
-                }
-                else {
-                    return this->base_bf.SetAbsoluteOffset(f_base_offset + offset);
-                }
-            }
-            case fs::Position::Current: {
-                if((f_cur_offset + offset) > f_size) {
-                    NTR_R_FAIL(ResultEndOfData);
-                }
-                else {
-                    return this->base_bf.SetAbsoluteOffset(f_base_offset + f_cur_offset + offset);
-                }
-            }
-            default: {
-                NTR_R_FAIL(ResultInvalidSeekPosition);
-            }
-        }
+        return this->subrange.SetOffset(offset, pos);
     }
 
     Result SDATFileHandle::GetOffsetImpl(size_t &out_offset) {
-        const auto f_base_offset = this->GetFileOffset();
-        size_t f_cur_offset;
-        NTR_R_TRY(this->base_bf.GetAbsoluteOffset(f_cur_offset));
-
-        out_offset = f_cur_offset - f_base_offset;
-        NTR_R_SUCCEED();
+        return this->subrange.GetOffset(out_offset);
     }
 
     Result SDATFileHandle::ReadImpl(void *read_buf, const size_t read_size, size_t &out_read_size) {
-        size_t f_offset;
-        NTR_R_TRY(this->GetOffset(f_offset));
-        size_t f_size;
-        NTR_R_TRY(this->GetSize(f_size));
-    
-        auto actual_read_size = read_size;
-        if((f_offset + actual_read_size) > f_size) {
-            actual_read_size = f_size - f_offset;
-        }
-
-        if(actual_read_size > 0) {
-            return this->base_bf.ReadData(read_buf, actual_read_size, out_read_size);
-        }
-        else {
-            NTR_R_FAIL(ResultEndOfData);
-        }
+        return this->subrange.Read(read_buf, read_size, out_read_size);
     }
 
     Result SDATFileHandle::CloseImpl() {
-        return this->base_bf.Close();
+        return this->subrange.Close();
+    }
+
+    Result SDATFileHandle::GetViewImpl(const size_t offset, const size_t size, std::shared_ptr<u8> &out_view) {
+        return this->subrange.GetView(offset, size, out_view);
     }
 
 }
\ No newline at end of file
@@ -13,6 +13,24 @@ namespace ntr::fmt {
 
         NTR_R_SUCCEED();
     }
+
+    Result SWAR::ReadSampleData(const Sample sample, std::shared_ptr<u8> &out_sample_data) {
+        fs::BinaryFile bf = {};
+        NTR_R_TRY(bf.Open(this->read_file_handle, this->read_path, fs::OpenMode::Read, this->comp));
+
+        // Borrow the sample straight from the file if possible, otherwise read it into a new buffer
+        const auto sample_data_offset = sample.info_offset + sizeof(SampleInfo);
+        if(bf.GetView(sample_data_offset, sample.data_size, out_sample_data).IsSuccess()) {
+            NTR_R_SUCCEED();
+        }
+
+        std::shared_ptr<u8> sample_data(util::NewArray<u8>(sample.data_size), std::default_delete<u8[]>());
+        NTR_R_TRY(bf.SetAbsoluteOffset(sample_data_offset));
+        NTR_R_TRY(bf.ReadDataExact(sample_data.get(), sample.data_size));
+
+        out_sample_data = std::move(sample_data);
+        NTR_R_SUCCEED();
+    }
     
     Result SWAR::WriteSampleData(const Sample sample, const u8 *sample_data, size_t sample_data_size, const std::string &path, std::shared_ptr<fs::FileHandle> file_handle) {
         fs::BinaryFile r_bf = {};
@@ -26,11 +44,13 @@ namespace ntr::fmt {
         NTR_R_TRY(w_bf.CopyFrom(r_bf, pre_sample_size));
 
         NTR_R_TRY(w_bf.SetAbsoluteOffset(sample.info_offset));
-        NTR_R_TRY(w_bf.Write(sample.info));
-
-        NTR_R_TRY(w_bf.WriteData(sample_data, sample_data_size));
+        const fs::WriteSegment sample_segments[] = {
+            { std::addressof(sample.info), sizeof(sample.info) },
+            { sample_data, sample_data_size }
+        };
+        NTR_R_TRY(w_bf.WriteV(sample_segments, std::size(sample_segments)));
         size_t pad_count = 0;
-        w_bf.WriteEnsureAlignment(0x20, pad_count);
+        NTR_R_TRY(w_bf.WriteEnsureAlignment(0x20, pad_count));
 
         const auto post_sample_r_offset = pre_sample_size + sample.data_size;
         const auto post_sample_w_offset = pre_sample_size + sample_data_size + pad_count;
@@ -40,19 +60,24 @@ namespace ntr::fmt {
 
         const auto base_offsets_offset = sizeof(Header) + sizeof(DataSection);
         const ssize_t size_diff = sample_data_size + pad_count - sample.data_size;
+        std::vector<fs::WriteSegment> info_offset_segments;
+        info_offset_segments.reserve(this->data.sample_count);
         for(u32 i = 0; i < this->data.sample_count; i++) {
             auto &cur_sample = this->samples[i];
             if(cur_sample.info_offset > sample.info_offset) {
                 cur_sample.info_offset += size_diff;
-                NTR_R_TRY(w_bf.SetAbsoluteOffset(base_offsets_offset + i * sizeof(Sample::info_offset)));
-                NTR_R_TRY(w_bf.Write(cur_sample.info_offset));
             }
             else if(cur_sample.info_offset == sample.info_offset) {
                 // Other info might have changed...
                 cur_sample = sample;
                 cur_sample.data_size = sample_data_size;
             }
+
+            // Unchanged offsets are rewritten as they are, so that the whole table goes in a single write
+            info_offset_segments.push_back({ std::addressof(cur_sample.info_offset), sizeof(cur_sample.info_offset) });
         }
+        NTR_R_TRY(w_bf.SetAbsoluteOffset(base_offsets_offset));
+        NTR_R_TRY(w_bf.WriteV(info_offset_segments));
 
         NTR_R_TRY(r_bf.SetAbsoluteOffset(post_sample_r_offset));
         NTR_R_TRY(w_bf.SetAbsoluteOffset(post_sample_w_offset));
@@ -62,15 +87,18 @@ namespace ntr::fmt {
         this->data.block_size += size_diff;
 
         NTR_R_TRY(w_bf.SetAbsoluteOffset(0));
-        NTR_R_TRY(w_bf.Write(this->header));
-
-        NTR_R_TRY(w_bf.Write(this->data));
+        const fs::WriteSegment header_segments[] = {
+            { std::addressof(this->header), sizeof(this->header) },
+            { std::addressof(this->data), sizeof(this->data) }
+        };
+        NTR_R_TRY(w_bf.WriteV(header_segments, std::size(header_segments)));
 
         NTR_R_SUCCEED();
     }
 
     Result SWAR::ValidateImpl(const std::string &path, std::shared_ptr<fs::FileHandle> file_handle, const fs::FileCompression comp) {
         fs::BinaryFile bf = {};
+        bf.SetStreamingDecompression(true);
         NTR_R_TRY(bf.Open(file_handle, path, fs::OpenMode::Read, comp));
 
         NTR_R_TRY(bf.Read(this->header));
@@ -32,6 +32,7 @@ namespace ntr::fmt::nfs {
                     // File
                     NitroFile nitro_file = {};
                     nitro_file.entry_offset = entry_offset;
+                    nitro_file.id = cur_file_id;
                     const auto name_len = entry_val;
                     NTR_R_TRY(bf.MoveOffset(name_len));
 
@@ -85,6 +86,17 @@ namespace ntr::fmt::nfs {
             }
         }
 
+        void UpdateNitroFileSizeImpl(nfs::NitroDirectory &dir, const NitroFile &this_file, const size_t new_file_size) {
+            for(auto &file : dir.files) {
+                if(file.id == this_file.id) {
+                    file.size = new_file_size;
+                }
+            }
+            for(auto &subdir : dir.dirs) {
+                UpdateNitroFileSizeImpl(subdir, this_file, new_file_size);
+            }
+        }
+
     }
 
     Result NitroEntryBase::GetName(fs::BinaryFile &base_bf, std::string &out_name) const {
@@ -97,12 +109,12 @@ namespace ntr::fmt::nfs {
 
             u8 entry_val;
             NTR_R_TRY(base_bf.Read(entry_val));
-            char name[128] = {};
             if(entry_val > 128) {
                 entry_val -= 128;
             }
-            NTR_R_TRY(base_bf.ReadDataExact(name, entry_val));
-            out_name.assign(name);
+            const u8 *name;
+            NTR_R_TRY(base_bf.ReadSpan(entry_val, name));
+            out_name.assign(reinterpret_cast<const char*>(name), strnlen(reinterpret_cast<const char*>(name), entry_val));
             NTR_R_SUCCEED();
         }        
     }
@@ -178,9 +190,109 @@ namespace ntr::fmt::nfs {
         NTR_R_SUCCEED();
     }
 
+    Result NitroFsFileFormat::SaveFileSystemInPlace(const std::vector<std::pair<fs::ExternalFsFile, NitroFile>> &nfs_files, bool &out_saved) {
+        out_saved = false;
+
+        // Compressed containers need to be recompressed entirely anyway
+        if(this->comp != fs::FileCompression::None) {
+            NTR_R_SUCCEED();
+        }
+
+        fs::BinaryFile bf;
+        if(bf.Open(this->read_file_handle, this->read_path, fs::OpenMode::ReadWrite).IsFailure()) {
+            // The file can't be overwritten through this handle, so it will be rewritten instead
+            NTR_R_SUCCEED();
+        }
+
+        size_t self_size;
+        NTR_R_TRY(bf.GetSize(self_size));
+        const auto base_offset = this->GetBaseOffset();
+        size_t data_align;
+        if(!this->GetAlignmentBetweenFileData(data_align)) {
+            data_align = 1;
+        }
+
+        const auto fat_entries_offset = this->GetFatEntriesOffset();
+        const auto fat_entry_count = this->GetFatEntryCount();
+        auto fat_entries = util::NewArray<FileAllocationTableEntry>(fat_entry_count);
+        ScopeGuard on_exit_cleanup([&]() {
+            delete[] fat_entries;
+        });
+        NTR_R_TRY(bf.SetAbsoluteOffset(fat_entries_offset));
+        NTR_R_TRY(bf.ReadDataExact(fat_entries, sizeof(FileAllocationTableEntry) * fat_entry_count));
+
+        // Check that every file fits first, so that nothing is touched if any of them doesn't
+        for(const auto &[ext_fs_file, nfs_file] : nfs_files) {
+            const auto file_end_offset = nfs_file.offset + nfs_file.size;
+            auto slot_end_offset = util::AlignUp(file_end_offset, data_align);
+            for(size_t i = 0; i < fat_entry_count; i++) {
+                const auto &entry = fat_entries[i];
+                if(entry.file_start > nfs_file.offset) {
+                    slot_end_offset = std::min<size_t>(slot_end_offset, entry.file_start);
+                }
+            }
+            // Never grow the container itself
+            slot_end_offset = std::min<size_t>(slot_end_offset, self_size - base_offset);
+
+            const auto new_file_size = ext_fs_file.size;
+            if((nfs_file.offset + new_file_size) > std::max(slot_end_offset, file_end_offset)) {
+                NTR_R_SUCCEED();
+            }
+        }
+
+        for(const auto &[ext_fs_file, nfs_file] : nfs_files) {
+            const auto new_file_size = ext_fs_file.size;
+            {
+                fs::BinaryFile d_bf;
+                NTR_R_TRY(fs::OpenExternalFsFile(ext_fs_file, fs::OpenMode::Read, d_bf));
+                NTR_R_TRY(bf.SetAbsoluteOffset(base_offset + nfs_file.offset));
+                NTR_R_TRY(bf.CopyFrom(d_bf, new_file_size));
+            }
+
+            // Don't leave stale data of the old file behind
+            if(new_file_size < nfs_file.size) {
+                NTR_R_TRY(bf.WriteFill(0, nfs_file.size - new_file_size));
+            }
+
+            auto &entry = fat_entries[nfs_file.id];
+            entry.file_end = entry.file_start + new_file_size;
+            NTR_R_TRY(bf.SetAbsoluteOffset(fat_entries_offset + nfs_file.id * sizeof(FileAllocationTableEntry)));
+            NTR_R_TRY(bf.Write(entry));
+
+            UpdateNitroFileSizeImpl(this->nitro_fs, nfs_file, new_file_size);
+        }
+
+        /* format-specific final writes (at the end of the file, like after a full rewrite) */
+        NTR_R_TRY(bf.SetAbsoluteOffset(self_size));
+        NTR_R_TRY(this->OnFileSystemWrite(bf, 0));
+
+        out_saved = true;
+        NTR_R_SUCCEED();
+    }
+
     Result NitroFsFileFormat::SaveFileSystem() {
-        std::vector<std::string> ext_fs_files;
-        NTR_R_TRY(fs::ListAllStdioFiles(this->ext_fs_root_path, ext_fs_files));
+        // Staged files still waiting to be compressed are all compressed (in parallel) now, before the layout is computed from their sizes
+        NTR_R_TRY(fs::FlushDeferredCompression());
+
+        // Staged files already know their IDs, so just get their current location from the FAT
+        std::vector<std::pair<fs::ExternalFsFile, NitroFile>> nfs_files;
+        if(!this->ext_fs_files.empty()) {
+            NTR_R_TRY(this->DoWithReadFile([&](fs::BinaryFile &bf) {
+                const auto fat_entries_offset = this->GetFatEntriesOffset();
+                for(const auto &[path, ext_fs_file] : this->ext_fs_files) {
+                    NTR_R_TRY(bf.SetAbsoluteOffset(fat_entries_offset + ext_fs_file.file_id * sizeof(FileAllocationTableEntry)));
+                    FileAllocationTableEntry fat_entry;
+                    NTR_R_TRY(bf.Read(fat_entry));
+
+                    NitroFile nfs_file = {};
+                    nfs_file.id = ext_fs_file.file_id;
+                    nfs_file.offset = fat_entry.file_start;
+                    nfs_file.size = fat_entry.file_end - fat_entry.file_start;
+                    nfs_files.push_back(std::make_pair(ext_fs_file, nfs_file));
+                }
+                NTR_R_SUCCEED();
+            }));
+        }
 
         auto w_path = this->write_path;
         auto w_file_handle = this->write_file_handle;
@@ -192,20 +304,26 @@ namespace ntr::fmt::nfs {
             w_path = this->ext_fs_root_path + "_tmp_" + fs::GetFileName(this->read_path);
         }
 
-        if(!ext_fs_files.empty()) {
-            std::vector<std::pair<std::string, NitroFile>> nfs_files;
-            for(const auto &ext_fs_file : ext_fs_files) {
-                const auto nfs_path = this->GetBasePath(ext_fs_file);
-                NitroFile nfs_file = {};
-                NTR_R_TRY(this->LookupFile(nfs_path, nfs_file));
-                nfs_files.push_back(std::make_pair(ext_fs_file, nfs_file));
-            }
-
-            std::sort(nfs_files.begin(), nfs_files.end(), [](const std::pair<std::string, NitroFile> &p_a, const std::pair<std::string, NitroFile> &p_b) -> bool {
+        if(!nfs_files.empty()) {
+            std::sort(nfs_files.begin(), nfs_files.end(), [](const std::pair<fs::ExternalFsFile, NitroFile> &p_a, const std::pair<fs::ExternalFsFile, NitroFile> &p_b) -> bool {
                 return p_a.second.offset < p_b.second.offset;
             });
 
+            if(write_on_self) {
+                bool saved_in_place;
+                NTR_R_TRY(this->SaveFileSystemInPlace(nfs_files, saved_in_place));
+                if(saved_in_place) {
+                    for(const auto &[ext_fs_file, _nfs_file] : nfs_files) {
+                        fs::DeleteExternalFsFile(ext_fs_file);
+                    }
+                    this->ext_fs_files.clear();
+                    NTR_R_SUCCEED();
+                }
+            }
+
             fs::BinaryFile w_bf;
+            // The new container is used right after being written, so it can't wait to be compressed
+            w_bf.SetCompressionDeferrable(false);
             NTR_R_TRY(w_bf.Open(w_file_handle, w_path, fs::OpenMode::Write, this->comp));
 
             fs::BinaryFile r_bf;
@@ -232,11 +350,10 @@ namespace ntr::fmt::nfs {
             for(auto &[ext_fs_file, nfs_file] : nfs_files) {
                 const auto nfs_file_w_offset = nfs_file.offset + size_diff;
                 const auto nfs_file_r_offset = nfs_file.offset;
-                size_t new_file_size;
-                NTR_R_TRY(fs::GetStdioFileSize(ext_fs_file, new_file_size));
+                const auto new_file_size = ext_fs_file.size;
                 {
                     fs::BinaryFile d_bf;
-                    NTR_R_TRY(d_bf.Open(std::make_shared<fs::StdioFileHandle>(), ext_fs_file, fs::OpenMode::Read));
+                    NTR_R_TRY(fs::OpenExternalFsFile(ext_fs_file, fs::OpenMode::Read, d_bf));
                     NTR_R_TRY(w_bf.SetAbsoluteOffset(base_offset + nfs_file_w_offset));
                     NTR_R_TRY(w_bf.CopyFrom(d_bf, new_file_size));
                 }
@@ -251,21 +368,14 @@ namespace ntr::fmt::nfs {
                 if(has_next_file) {
                     const auto &[next_ext_fs_file, next_nfs_file] = nfs_files[i + 1];
                     const auto data_between_files_offset = base_offset + nfs_file_r_offset + nfs_file.size;
-                    auto data_between_files_size = next_nfs_file.offset - nfs_file_r_offset - nfs_file.size;
-                    if(this->GetAlignmentBetweenFileData(data_align)) {
-                        size_t cur_w_bf_offset;
-                        NTR_R_TRY(w_bf.GetAbsoluteOffset(cur_w_bf_offset));
-                        auto tmp_align_offset = cur_w_bf_offset + data_between_files_size;
-                        auto data_between_files_pad_size = 0;
-                        while(!util::IsAlignedTo(tmp_align_offset, data_align)) {
-                            tmp_align_offset++;
-                            data_between_files_pad_size++;
-                        }
-                        data_between_files_size += data_between_files_pad_size;
-                    }
-                    
+                    const auto data_between_files_size = next_nfs_file.offset - nfs_file_r_offset - nfs_file.size;
                     NTR_R_TRY(r_bf.SetAbsoluteOffset(data_between_files_offset));
                     NTR_R_TRY(w_bf.CopyFrom(r_bf, data_between_files_size));
+
+                    if(this->GetAlignmentBetweenFileData(data_align)) {
+                        size_t data_between_files_pad_size;
+                        NTR_R_TRY(w_bf.WriteEnsureAlignment(data_align, data_between_files_pad_size));
+                    }
                 }
 
                 const ssize_t cur_size_diff = new_file_size + pad_size - nfs_file.size;
@@ -309,6 +419,8 @@ namespace ntr::fmt::nfs {
         }
         else {
             fs::BinaryFile w_bf;
+            // Same as above, it can't wait to be compressed
+            w_bf.SetCompressionDeferrable(false);
             NTR_R_TRY(w_bf.Open(w_file_handle, w_path, fs::OpenMode::Write, this->comp));
 
             fs::BinaryFile r_bf;
@@ -322,25 +434,16 @@ namespace ntr::fmt::nfs {
         }
 
         if(write_on_self) {
-            fs::BinaryFile w_bf;
-            NTR_R_TRY(w_bf.Open(this->read_file_handle, this->read_path, fs::OpenMode::Write));
-
-            fs::BinaryFile r_bf;
-            NTR_R_TRY(r_bf.Open(w_file_handle, w_path, fs::OpenMode::Read));
-
-            size_t r_file_size;
-            NTR_R_TRY(r_bf.GetSize(r_file_size));
-            NTR_R_TRY(w_bf.CopyFrom(r_bf, r_file_size));
-
-            NTR_R_TRY(fs::DeleteStdioFile(w_path));
+            NTR_R_TRY(fs::CommitStdioFile(this->read_file_handle, this->read_path, w_path));
 
             w_file_handle = nullptr;
             w_path.clear();
         }
 
-        for(const auto &ext_fs_file : ext_fs_files) {
-            fs::DeleteStdioFile(ext_fs_file);
+        for(const auto &[ext_fs_file, _nfs_file] : nfs_files) {
+            fs::DeleteExternalFsFile(ext_fs_file);
         }
+        this->ext_fs_files.clear();
 
         NTR_R_SUCCEED();
     }
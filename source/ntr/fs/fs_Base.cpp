@@ -17,7 +17,7 @@ namespace ntr::fs {
         return g_ExternalFsDirectory;
     }
 
-    ExternalFsFileFormat::ExternalFsFileFormat() : ext_fs_id(static_cast<u32>(rand())) {
+    ExternalFsFileFormat::ExternalFsFileFormat() : ext_fs_id(static_cast<u32>(rand())), ext_fs_mem_budget(DefaultExternalFsMemoryBudget), ext_fs_use_count(0) {
         this->ext_fs_root_path = g_ExternalFsDirectory + "/" + std::to_string(this->ext_fs_id);
     }
 
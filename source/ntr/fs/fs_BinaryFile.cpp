@@ -1,4 +1,12 @@
 #include <ntr/fs/fs_BinaryFile.hpp>
+#include <ntr/fs/fs_Stdio.hpp>
+#include <algorithm>
+
+#ifdef NTR_HOST_BUILD
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#endif
 
 extern void Log(const std::string &log);
 
@@ -6,22 +14,392 @@ namespace ntr::fs {
 
     // Only way to handle compression is to read all the file and decompress it in an internal buffer.
     // Let's hope this doesn't make us run out of memory with big files.
+    // (Reads that don't need all of it can stream the decompression instead, see SetStreamingDecompression)
 
     namespace {
 
-        inline constexpr size_t GetAllocateSize(const size_t size) {
-            size_t alloc_size = ReallocBufferSize;
-            auto base_size = size;
-            while(base_size > ReallocBufferSize) {
-                alloc_size += ReallocBufferSize;
-                base_size -= ReallocBufferSize;
+        util::LzCompressionLevel g_LzCompressionLevel = util::DefaultLzCompressionLevel;
+
+        struct DeferredCompressionEntry {
+            std::shared_ptr<FileHandle> file_handle;
+            std::string path;
+            util::LzVersion lz_ver;
+            std::shared_ptr<u8> dec_data;
+            size_t dec_size;
+        };
+
+        bool g_DeferredCompressionEnabled = false;
+        size_t g_DeferredCompressionThreadCount = 0;
+        size_t g_DeferredCompressionMemoryBudget = DefaultDeferredCompressionMemoryBudget;
+        std::vector<DeferredCompressionEntry> g_DeferredCompressionEntries;
+        size_t g_DeferredCompressionSize = 0;
+
+        // Note: any handle might be reaching the same actual file, so just match paths
+        bool IsDeferredCompressionPending(const std::string &path) {
+            for(const auto &entry : g_DeferredCompressionEntries) {
+                if(entry.path == path) {
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        // Copy buffers are big, so keep a few of them around instead of allocating new ones for every copy
+        constexpr size_t MaxPooledCopyBufferCount = 2;
+        std::vector<std::unique_ptr<u8[]>> g_PooledCopyBuffers;
+
+        inline u8 *AcquireCopyBuffer() {
+            if(g_PooledCopyBuffers.empty()) {
+                return util::NewArray<u8>(PooledCopyBufferSize);
+            }
+
+            auto copy_buf = g_PooledCopyBuffers.back().release();
+            g_PooledCopyBuffers.pop_back();
+            return copy_buf;
+        }
+
+        inline void ReleaseCopyBuffer(u8 *copy_buf) {
+            std::unique_ptr<u8[]> copy_buf_ptr(copy_buf);
+            if((copy_buf_ptr != nullptr) && (g_PooledCopyBuffers.size() < MaxPooledCopyBufferCount)) {
+                g_PooledCopyBuffers.push_back(std::move(copy_buf_ptr));
+            }
+        }
+
+        struct DecompressedImageCacheEntry {
+            std::weak_ptr<FileHandle> file_handle;
+            std::string path;
+            size_t enc_size;
+            util::LzVersion lz_ver;
+            size_t dec_size;
+            std::weak_ptr<u8> dec_data;
+            std::shared_ptr<u8> pinned_dec_data;
+        };
+
+        // Most recently used entries first
+        std::vector<DecompressedImageCacheEntry> g_DecompressedImageCache;
+        size_t g_DecompressedImageCacheSize = DefaultDecompressedImageCacheSize;
+
+        void UpdateDecompressedImageCache() {
+            size_t pinned_size = 0;
+            for(auto &entry : g_DecompressedImageCache) {
+                if(entry.pinned_dec_data) {
+                    if((pinned_size + entry.dec_size) <= g_DecompressedImageCacheSize) {
+                        pinned_size += entry.dec_size;
+                    }
+                    else {
+                        entry.pinned_dec_data.reset();
+                    }
+                }
+            }
+
+            g_DecompressedImageCache.erase(std::remove_if(g_DecompressedImageCache.begin(), g_DecompressedImageCache.end(), [](const DecompressedImageCacheEntry &entry) -> bool {
+                return entry.file_handle.expired() || entry.dec_data.expired();
+            }), g_DecompressedImageCache.end());
+        }
+
+        bool LookupDecompressedImageCache(const std::shared_ptr<FileHandle> &file_handle, const std::string &path, const size_t enc_size, std::shared_ptr<u8> &out_dec_data, size_t &out_dec_size, util::LzVersion &out_lz_ver) {
+            for(auto it = g_DecompressedImageCache.begin(); it != g_DecompressedImageCache.end(); it++) {
+                if((it->file_handle.lock() == file_handle) && (it->path == path) && (it->enc_size == enc_size)) {
+                    auto dec_data = it->dec_data.lock();
+                    if(!dec_data) {
+                        return false;
+                    }
+
+                    out_dec_data = dec_data;
+                    out_dec_size = it->dec_size;
+                    out_lz_ver = it->lz_ver;
+
+                    auto entry = std::move(*it);
+                    entry.pinned_dec_data = dec_data;
+                    g_DecompressedImageCache.erase(it);
+                    g_DecompressedImageCache.insert(g_DecompressedImageCache.begin(), std::move(entry));
+                    UpdateDecompressedImageCache();
+                    return true;
+                }
             }
-            return alloc_size;
+
+            return false;
+        }
+
+        void RegisterDecompressedImageCache(const std::shared_ptr<FileHandle> &file_handle, const std::string &path, const size_t enc_size, const std::shared_ptr<u8> &dec_data, const size_t dec_size, const util::LzVersion lz_ver) {
+            const DecompressedImageCacheEntry entry = {
+                .file_handle = file_handle,
+                .path = path,
+                .enc_size = enc_size,
+                .lz_ver = lz_ver,
+                .dec_size = dec_size,
+                .dec_data = dec_data,
+                .pinned_dec_data = dec_data
+            };
+            g_DecompressedImageCache.insert(g_DecompressedImageCache.begin(), std::move(entry));
+            UpdateDecompressedImageCache();
         }
 
+        struct CheckpointIndexCacheEntry {
+            std::weak_ptr<FileHandle> file_handle;
+            std::string path;
+            size_t enc_size;
+            std::shared_ptr<util::LzCheckpointIndex> index;
+        };
+
+        constexpr size_t MaxCachedCheckpointIndexCount = 8;
+
+        // Most recently used entries first
+        std::vector<CheckpointIndexCacheEntry> g_CheckpointIndexCache;
+
+        std::shared_ptr<util::LzCheckpointIndex> GetCheckpointIndex(const std::shared_ptr<FileHandle> &file_handle, const std::string &path, const size_t enc_size, const size_t interval) {
+            for(auto it = g_CheckpointIndexCache.begin(); it != g_CheckpointIndexCache.end(); it++) {
+                if((it->file_handle.lock() == file_handle) && (it->path == path) && (it->enc_size == enc_size) && (it->index->interval == interval)) {
+                    auto entry = std::move(*it);
+                    g_CheckpointIndexCache.erase(it);
+                    g_CheckpointIndexCache.insert(g_CheckpointIndexCache.begin(), entry);
+                    return entry.index;
+                }
+            }
+
+            g_CheckpointIndexCache.erase(std::remove_if(g_CheckpointIndexCache.begin(), g_CheckpointIndexCache.end(), [](const CheckpointIndexCacheEntry &entry) -> bool {
+                return entry.file_handle.expired();
+            }), g_CheckpointIndexCache.end());
+            if(g_CheckpointIndexCache.size() >= MaxCachedCheckpointIndexCount) {
+                g_CheckpointIndexCache.pop_back();
+            }
+
+            const CheckpointIndexCacheEntry entry = {
+                .file_handle = file_handle,
+                .path = path,
+                .enc_size = enc_size,
+                .index = std::make_shared<util::LzCheckpointIndex>(interval)
+            };
+            g_CheckpointIndexCache.insert(g_CheckpointIndexCache.begin(), entry);
+            return entry.index;
+        }
+
+        #ifdef NTR_HOST_BUILD
+
+        size_t g_PipelinedCopyDepth = DefaultPipelinedCopyDepth;
+        size_t g_PipelinedCopyChunkSize = DefaultPipelinedCopyChunkSize;
+
+        // Nested files end up being accessed through the outermost file's handle, so that's the one each thread would really use
+        // Only plain native files are known not to share it with anything else, so anything else is null here (and never copied in parallel)
+        std::shared_ptr<FileHandle> GetExclusiveRootFileHandle(const std::shared_ptr<FileHandle> &file_handle, const std::string &path) {
+            auto root_handle = file_handle;
+            auto root_path = path;
+            std::shared_ptr<FileHandle> parent_handle;
+            std::string parent_path;
+            size_t parent_offset;
+            size_t parent_size;
+            while(root_handle->GetSubrange(root_path, parent_handle, parent_path, parent_offset, parent_size)) {
+                root_handle = std::move(parent_handle);
+                root_path = std::move(parent_path);
+            }
+
+            int fd;
+            if(!root_handle->GetNativeFileDescriptor(fd)) {
+                return nullptr;
+            }
+            return root_handle;
+        }
+
+        // Note: the reader thread only touches the source file (and the caches only the source uses), while this thread only touches the destination file
+        // A read error still lets everything read before it be written, just like a sequential copy
+
+        Result PipelinedCopy(BinaryFile &in_bf, BinaryFile &out_bf, const size_t size, u8 **chunk_bufs, const size_t depth, const size_t chunk_size) {
+            std::mutex lock;
+            std::condition_variable cond;
+            std::vector<size_t> chunk_sizes(depth);
+            size_t filled_count = 0;
+            size_t drained_count = 0;
+            bool read_done = false;
+            bool cancelled = false;
+            auto read_rc = ResultSuccess;
+
+            std::thread reader([&]() {
+                auto cur_left_size = size;
+                while(cur_left_size > 0) {
+                    {
+                        std::unique_lock<std::mutex> guard(lock);
+                        cond.wait(guard, [&]() {
+                            return cancelled || ((filled_count - drained_count) < depth);
+                        });
+                        if(cancelled) {
+                            break;
+                        }
+                    }
+
+                    const auto chunk_idx = filled_count % depth;
+                    size_t read_size;
+                    const auto rc = in_bf.ReadData(chunk_bufs[chunk_idx], std::min(chunk_size, cur_left_size), read_size);
+                    if(rc.IsFailure()) {
+                        std::lock_guard<std::mutex> guard(lock);
+                        read_rc = rc;
+                        break;
+                    }
+                    cur_left_size -= read_size;
+
+                    {
+                        std::lock_guard<std::mutex> guard(lock);
+                        chunk_sizes[chunk_idx] = read_size;
+                        filled_count++;
+                    }
+                    cond.notify_all();
+                }
+
+                {
+                    std::lock_guard<std::mutex> guard(lock);
+                    read_done = true;
+                }
+                cond.notify_all();
+            });
+
+            auto write_rc = ResultSuccess;
+            while(true) {
+                size_t chunk_idx;
+                {
+                    std::unique_lock<std::mutex> guard(lock);
+                    cond.wait(guard, [&]() {
+                        return read_done || (drained_count < filled_count);
+                    });
+                    if(drained_count == filled_count) {
+                        break;
+                    }
+                    chunk_idx = drained_count % depth;
+                }
+
+                write_rc = out_bf.WriteData(chunk_bufs[chunk_idx], chunk_sizes[chunk_idx]);
+                {
+                    std::lock_guard<std::mutex> guard(lock);
+                    if(write_rc.IsFailure()) {
+                        cancelled = true;
+                    }
+                    else {
+                        drained_count++;
+                    }
+                }
+                cond.notify_all();
+                if(write_rc.IsFailure()) {
+                    break;
+                }
+            }
+
+            reader.join();
+            NTR_R_TRY(write_rc);
+            NTR_R_TRY(read_rc);
+            NTR_R_SUCCEED();
+        }
+
+        #endif
+
     }
 
-    Result BinaryFile::LoadDecompressedData() {
+    #ifdef NTR_HOST_BUILD
+
+    void SetPipelinedCopy(const size_t depth, const size_t chunk_size) {
+        g_PipelinedCopyDepth = depth;
+        g_PipelinedCopyChunkSize = chunk_size;
+    }
+
+    #endif
+
+    void SetLzCompressionLevel(const util::LzCompressionLevel level) {
+        g_LzCompressionLevel = level;
+    }
+
+    void SetDeferredCompression(const bool enable, const size_t thread_count, const size_t mem_budget) {
+        g_DeferredCompressionEnabled = enable;
+        g_DeferredCompressionThreadCount = thread_count;
+        g_DeferredCompressionMemoryBudget = mem_budget;
+    }
+
+    Result FlushDeferredCompression() {
+        // Take them all first, since writing them back might open other files (which would flush them again)
+        auto entries = std::move(g_DeferredCompressionEntries);
+        g_DeferredCompressionEntries.clear();
+        g_DeferredCompressionSize = 0;
+        if(entries.empty()) {
+            NTR_R_SUCCEED();
+        }
+
+        std::vector<util::LzCompressJob> jobs;
+        jobs.reserve(entries.size());
+        for(const auto &entry : entries) {
+            const util::LzCompressJob job = {
+                .data = entry.dec_data.get(),
+                .data_size = entry.dec_size,
+                .ver = entry.lz_ver,
+                .repeat_size = util::GetMaximumRepeatSize(entry.lz_ver),
+                .level = g_LzCompressionLevel
+            };
+            jobs.push_back(job);
+        }
+        ScopeGuard on_exit_cleanup([&]() {
+            for(auto &job : jobs) {
+                delete[] job.out_data;
+            }
+        });
+
+        const auto compress_rc = util::LzCompressBatch(jobs.data(), jobs.size(), g_DeferredCompressionThreadCount, g_DeferredCompressionMemoryBudget);
+
+        // Still write back every file that was compressed
+        auto write_rc = ResultSuccess;
+        std::vector<DeferredCompressionEntry> failed_entries;
+        for(size_t i = 0; i < entries.size(); i++) {
+            auto &entry = entries[i];
+            const auto &job = jobs[i];
+            if(job.rc.IsFailure()) {
+                failed_entries.push_back(std::move(entry));
+                continue;
+            }
+
+            InvalidateDecompressedImageCache(entry.path);
+            auto rc = entry.file_handle->Open(entry.path, OpenMode::Write);
+            if(rc.IsSuccess()) {
+                rc = entry.file_handle->Write(job.out_data, job.out_size);
+                const auto close_rc = entry.file_handle->Close();
+                if(rc.IsSuccess()) {
+                    rc = close_rc;
+                }
+            }
+            if(rc.IsFailure()) {
+                failed_entries.push_back(std::move(entry));
+                if(write_rc.IsSuccess()) {
+                    write_rc = rc;
+                }
+            }
+        }
+
+        // Failed files are pending again (ahead of any deferred meanwhile), so that their data isn't lost
+        for(const auto &entry : failed_entries) {
+            g_DeferredCompressionSize += entry.dec_size;
+        }
+        g_DeferredCompressionEntries.insert(g_DeferredCompressionEntries.begin(), std::make_move_iterator(failed_entries.begin()), std::make_move_iterator(failed_entries.end()));
+
+        NTR_R_TRY(compress_rc);
+        NTR_R_TRY(write_rc);
+        NTR_R_SUCCEED();
+    }
+
+    void SetDecompressedImageCacheSize(const size_t size) {
+        g_DecompressedImageCacheSize = size;
+        UpdateDecompressedImageCache();
+    }
+
+    void ClearDecompressedImageCache() {
+        g_DecompressedImageCache.clear();
+        g_CheckpointIndexCache.clear();
+    }
+
+    void InvalidateDecompressedImageCache(const std::string &path) {
+        // Note: any handle might be writing to the same actual file, so just match paths
+        g_DecompressedImageCache.erase(std::remove_if(g_DecompressedImageCache.begin(), g_DecompressedImageCache.end(), [&](const DecompressedImageCacheEntry &entry) -> bool {
+            return entry.path == path;
+        }), g_DecompressedImageCache.end());
+        g_CheckpointIndexCache.erase(std::remove_if(g_CheckpointIndexCache.begin(), g_CheckpointIndexCache.end(), [&](const CheckpointIndexCacheEntry &entry) -> bool {
+            return entry.path == path;
+        }), g_CheckpointIndexCache.end());
+    }
+
+    Result BinaryFile::LoadDecompressedData(const std::string &path) {
         if(!this->IsCompressed()) {
             NTR_R_FAIL(ResultFileNotCompressed);
         }
@@ -30,6 +408,20 @@ namespace ntr::fs {
             size_t file_size;
             NTR_R_TRY(this->file_handle->GetSize(file_size));
 
+            if(LookupDecompressedImageCache(this->file_handle, path, file_size, this->dec_file_data, this->dec_file_size, this->comp_lz_ver)) {
+                this->dec_file_offset = 0;
+                NTR_R_SUCCEED();
+            }
+
+            if(this->dec_streaming && (this->comp == FileCompression::LZ77)) {
+                this->lz_enc_file_size = file_size;
+                this->dec_file_offset = 0;
+                if(this->lz_index_interval > 0) {
+                    this->lz_index = GetCheckpointIndex(this->file_handle, path, file_size, this->lz_index_interval);
+                }
+                return this->StartStreamedDecompression();
+            }
+
             u32 lz_header;
             size_t read_size;
             NTR_R_TRY(this->file_handle->SetOffset(0, Position::Begin));
@@ -61,8 +453,21 @@ namespace ntr::fs {
 
             switch(this->comp) {
                 case FileCompression::LZ77: {
+                    size_t dec_size;
+                    size_t header_size;
+                    NTR_R_TRY(util::LzReadHeader(enc_file_data, file_size, this->comp_lz_ver, dec_size, header_size));
+                    // The header can't be trusted: never allocate more than the file could possibly decompress to
+                    if(dec_size > util::GetLzMaximumDecompressedSize(this->comp_lz_ver, file_size - header_size)) {
+                        NTR_R_FAIL(ResultCompressionInvalidDecompressedSize);
+                    }
+
+                    std::shared_ptr<u8> dec_data(util::NewArray<u8>(dec_size), std::default_delete<u8[]>());
+                    if(!dec_data && (dec_size > 0)) {
+                        NTR_R_FAIL(ResultCompressionAllocationFailure);
+                    }
                     size_t dummy_size;
-                    NTR_R_TRY(util::LzDecompress(enc_file_data, this->dec_file_data, this->dec_file_size, this->comp_lz_ver, dummy_size));
+                    NTR_R_TRY(util::LzDecompress(enc_file_data, file_size, dec_data.get(), dec_size, this->comp_lz_ver, this->dec_file_size, dummy_size));
+                    this->dec_file_data = std::move(dec_data);
                     break;
                 }
                 default: {
@@ -70,8 +475,9 @@ namespace ntr::fs {
                 }
             }
 
-            this->dec_file_buf_size = this->dec_file_size;
-            this->dec_file_offset = 0;            
+            this->dec_file_offset = 0;
+
+            RegisterDecompressedImageCache(this->file_handle, path, file_size, this->dec_file_data, this->dec_file_size, this->comp_lz_ver);
         }
 
         NTR_R_SUCCEED();
@@ -85,24 +491,58 @@ namespace ntr::fs {
             NTR_R_FAIL(ResultWriteNotSupported);
         }
 
-        u8 *enc_file_data;
-        size_t enc_file_data_size;
+        // The written data is compressed straight from its chunks into the file, without ever being put together
+        NTR_R_TRY(this->file_handle->SetOffset(0, Position::Begin));
+
+        size_t dec_offset = 0;
+        const util::LzReadFunction read_fn = [&](u8 *read_buf, const size_t read_size, size_t &out_read_size) -> Result {
+            const auto actual_read_size = std::min(read_size, this->dec_file_size - dec_offset);
+            NTR_R_TRY(this->dec_file_chunks.Read(dec_offset, read_buf, actual_read_size));
+            dec_offset += actual_read_size;
+            out_read_size = actual_read_size;
+            NTR_R_SUCCEED();
+        };
+        const util::LzWriteFunction write_fn = [&](const u8 *write_buf, const size_t write_size) -> Result {
+            return this->file_handle->Write(write_buf, write_size);
+        };
+
         switch(this->comp) {
             case FileCompression::LZ77: {
-                NTR_R_TRY(util::LzCompressDefault(this->dec_file_data, this->dec_file_size, this->comp_lz_ver, enc_file_data, enc_file_data_size));
+                size_t dummy_size;
+                NTR_R_TRY(util::LzCompressStream(this->dec_file_size, this->comp_lz_ver, util::GetMaximumRepeatSize(this->comp_lz_ver), g_LzCompressionLevel, read_fn, write_fn, dummy_size));
                 break;
             }
             default: {
                 break;
             }
         }
-        ScopeGuard on_exit_cleanup([&]() {
-            delete[] enc_file_data;
-        });
 
-        NTR_R_TRY(this->file_handle->SetOffset(0, Position::Begin));
-        NTR_R_TRY(this->file_handle->Write(enc_file_data, enc_file_data_size));
+        NTR_R_SUCCEED();
+    }
+
+    Result BinaryFile::DeferCompressedData() {
+        if(!this->IsCompressed()) {
+            NTR_R_FAIL(ResultFileNotCompressed);
+        }
+        if(!this->CanWrite()) {
+            NTR_R_FAIL(ResultWriteNotSupported);
+        }
 
+        std::shared_ptr<u8> dec_data(util::NewArray<u8>(this->dec_file_size), std::default_delete<u8[]>());
+        if(!dec_data && (this->dec_file_size > 0)) {
+            NTR_R_FAIL(ResultCompressionAllocationFailure);
+        }
+        this->dec_file_chunks.CopyTo(dec_data.get());
+
+        const DeferredCompressionEntry entry = {
+            .file_handle = this->file_handle,
+            .path = this->path,
+            .lz_ver = this->comp_lz_ver,
+            .dec_data = std::move(dec_data),
+            .dec_size = this->dec_file_size
+        };
+        g_DeferredCompressionEntries.push_back(std::move(entry));
+        g_DeferredCompressionSize += this->dec_file_size;
         NTR_R_SUCCEED();
     }
 
@@ -113,7 +553,7 @@ namespace ntr::fs {
         }
 
         if(actual_read_size > 0) {
-            std::memcpy(read_buf, this->dec_file_data + this->dec_file_offset, actual_read_size);
+            std::memcpy(read_buf, this->dec_file_data.get() + this->dec_file_offset, actual_read_size);
             this->dec_file_offset += actual_read_size;
             out_read_size = actual_read_size;
             NTR_R_SUCCEED();
@@ -124,55 +564,286 @@ namespace ntr::fs {
     }
 
     Result BinaryFile::WriteDecompressedData(const void *write_buf, const size_t write_size) {
-        if(this->dec_file_data == nullptr) {
-            const auto new_size = GetAllocateSize(write_size);
-            
-            this->dec_file_data = util::NewArray<u8>(new_size);
-            std::memcpy(this->dec_file_data, write_buf, write_size);
-            this->dec_file_offset = write_size;
-            this->dec_file_size = write_size;
-            this->dec_file_buf_size = new_size;
+        this->dec_file_chunks.Write(this->dec_file_offset, write_buf, write_size);
+        this->dec_file_offset += write_size;
+        this->dec_file_size = this->dec_file_chunks.GetSize();
+        NTR_R_SUCCEED();
+    }
+
+    Result BinaryFile::FillDecompressedData(const u8 value, const size_t count) {
+        this->dec_file_chunks.Fill(this->dec_file_offset, value, count);
+        this->dec_file_offset += count;
+        this->dec_file_size = this->dec_file_chunks.GetSize();
+        NTR_R_SUCCEED();
+    }
+
+    Result BinaryFile::ResizeDecompressedData(const size_t new_size) {
+        if(!this->CanWrite()) {
+            NTR_R_FAIL(ResultWriteNotSupported);
+        }
+
+        this->dec_file_chunks.Resize(new_size);
+        this->dec_file_size = new_size;
+        NTR_R_SUCCEED();
+    }
+
+    Result BinaryFile::ReadBufferedData(void *read_buf, const size_t read_size, size_t &out_read_size) {
+        auto out_buf = reinterpret_cast<u8*>(read_buf);
+        size_t done_size = 0;
+
+        if(this->IsInReadAheadWindow(this->ra_cur_offset)) {
+            const auto window_left_size = this->ra_window_offset + this->ra_window_size - this->ra_cur_offset;
+            done_size = std::min(window_left_size, read_size);
+            std::memcpy(out_buf, this->ra_buf + (this->ra_cur_offset - this->ra_window_offset), done_size);
+            this->ra_cur_offset += done_size;
+
+            if(done_size == read_size) {
+                this->ra_hit_count++;
+                out_read_size = done_size;
+                NTR_R_SUCCEED();
+            }
+        }
+
+        this->ra_miss_count++;
+        NTR_R_TRY(this->SyncReadAheadWindow());
+
+        // Big reads go straight to the file, there is nothing to gain by buffering them
+        const auto left_size = read_size - done_size;
+        if(left_size >= this->ra_buf_size) {
+            size_t direct_read_size;
+            const auto rc = this->file_handle->Read(out_buf + done_size, left_size, direct_read_size);
+            if(rc.IsFailure()) {
+                if(done_size > 0) {
+                    out_read_size = done_size;
+                    NTR_R_SUCCEED();
+                }
+                return rc;
+            }
+
+            out_read_size = done_size + direct_read_size;
             NTR_R_SUCCEED();
         }
 
-        if((this->dec_file_offset + write_size) > this->dec_file_buf_size) {
-            /* too small buffer, so let's realloc */
-            NTR_R_TRY(this->ReallocateDecompressedData(this->dec_file_offset + write_size));
+        if(this->ra_buf == nullptr) {
+            this->ra_buf = util::NewArray<u8>(this->ra_buf_size);
         }
-        std::memcpy(this->dec_file_data + this->dec_file_offset, write_buf, write_size);
-        this->dec_file_offset += write_size;
-        if(this->dec_file_offset > this->dec_file_size) {
-            this->dec_file_size = this->dec_file_offset;
+
+        size_t window_offset;
+        NTR_R_TRY(this->file_handle->GetOffset(window_offset));
+        size_t window_size;
+        const auto rc = this->file_handle->Read(this->ra_buf, this->ra_buf_size, window_size);
+        if(rc.IsFailure()) {
+            if(done_size > 0) {
+                out_read_size = done_size;
+                NTR_R_SUCCEED();
+            }
+            return rc;
         }
+
+        this->ra_window_offset = window_offset;
+        this->ra_window_size = window_size;
+        this->ra_cur_offset = window_offset;
+        this->ra_window_valid = true;
+
+        const auto window_read_size = std::min(window_size, left_size);
+        std::memcpy(out_buf + done_size, this->ra_buf, window_read_size);
+        this->ra_cur_offset += window_read_size;
+        out_read_size = done_size + window_read_size;
         NTR_R_SUCCEED();
     }
 
-    Result BinaryFile::ReallocateDecompressedData(const size_t new_size) {
-        if(!this->IsCompressed()) {
-            NTR_R_FAIL(ResultFileNotCompressed);
+    Result BinaryFile::SyncReadAheadWindow() {
+        // The underlying file is always positioned at the end of the window, move it back to where we actually are
+        if(this->ra_window_valid) {
+            this->ra_window_valid = false;
+
+            const auto window_end_offset = this->ra_window_offset + this->ra_window_size;
+            if(this->ra_cur_offset != window_end_offset) {
+                NTR_R_TRY(this->file_handle->SetOffset(this->ra_cur_offset, Position::Begin));
+            }
         }
 
-        const auto actual_new_size = GetAllocateSize(new_size);
-        auto new_dec_file_data = util::NewArray<u8>(actual_new_size);
-        std::memcpy(new_dec_file_data, this->dec_file_data, this->dec_file_offset);
-        delete[] this->dec_file_data;
-        this->dec_file_data = new_dec_file_data;
-        this->dec_file_size = new_size;
-        this->dec_file_buf_size = actual_new_size;
         NTR_R_SUCCEED();
     }
 
+    Result BinaryFile::StartStreamedDecompression() {
+        if(this->lz_dec == nullptr) {
+            this->lz_dec = new util::LzDecompressor();
+        }
+        if(this->lz_enc_buf == nullptr) {
+            this->lz_enc_buf = util::NewArray<u8>(StreamingDecompressionBufferSize);
+        }
+
+        // (Re)start from the very beginning of the compressed data
+        this->lz_enc_buf_offset = 0;
+        this->lz_enc_buf_size = 0;
+        this->lz_enc_file_offset = 0;
+        const auto header_read_size = std::min(StreamingDecompressionBufferSize, this->lz_enc_file_size);
+        if(header_read_size > 0) {
+            NTR_R_TRY(this->file_handle->SetOffset(0, Position::Begin));
+            NTR_R_TRY(this->file_handle->Read(this->lz_enc_buf, header_read_size, this->lz_enc_buf_size));
+            this->lz_enc_file_offset = this->lz_enc_buf_size;
+        }
+
+        size_t header_size;
+        NTR_R_TRY(this->lz_dec->Initialize(this->lz_enc_buf, this->lz_enc_buf_size, header_size));
+        this->lz_enc_buf_offset = header_size;
+
+        this->comp_lz_ver = this->lz_dec->GetVersion();
+        this->dec_file_size = this->lz_dec->GetDecompressedSize();
+        NTR_R_SUCCEED();
+    }
+
+    Result BinaryFile::ResumeStreamedDecompression(const util::LzCheckpoint &checkpoint) {
+        *this->lz_dec = checkpoint.dec;
+        this->lz_enc_buf_offset = 0;
+        this->lz_enc_buf_size = 0;
+        this->lz_enc_file_offset = checkpoint.enc_offset;
+        NTR_R_SUCCEED();
+    }
+
+    Result BinaryFile::DecompressStreamedData(u8 *out_buf, const size_t size, size_t &out_size) {
+        // Stop right at the next checkpoint (if any) so that it can be saved
+        auto actual_size = size;
+        if(this->lz_index) {
+            const auto next_checkpoint_offset = this->lz_index->GetNextCheckpointOffset();
+            const auto cur_dec_offset = this->lz_dec->GetDecompressedOffset();
+            if((next_checkpoint_offset > cur_dec_offset) && (next_checkpoint_offset < this->dec_file_size)) {
+                actual_size = std::min(actual_size, next_checkpoint_offset - cur_dec_offset);
+            }
+        }
+
+        out_size = 0;
+        while((out_size == 0) && !this->lz_dec->IsFinished()) {
+            size_t used_enc_size;
+            NTR_R_TRY(this->lz_dec->Decompress(this->lz_enc_buf + this->lz_enc_buf_offset, this->lz_enc_buf_size - this->lz_enc_buf_offset, used_enc_size, out_buf, actual_size, out_size));
+            this->lz_enc_buf_offset += used_enc_size;
+
+            if(out_size == 0) {
+                // Needs more compressed data: keep what wasn't used yet and refill the rest of the buffer
+                if(this->lz_enc_file_offset >= this->lz_enc_file_size) {
+                    NTR_R_FAIL(ResultCompressionInvalidLzFormat);
+                }
+
+                const auto left_size = this->lz_enc_buf_size - this->lz_enc_buf_offset;
+                std::memmove(this->lz_enc_buf, this->lz_enc_buf + this->lz_enc_buf_offset, left_size);
+                this->lz_enc_buf_offset = 0;
+                this->lz_enc_buf_size = left_size;
+
+                const auto fill_size = std::min(StreamingDecompressionBufferSize - left_size, this->lz_enc_file_size - this->lz_enc_file_offset);
+                size_t read_size;
+                NTR_R_TRY(this->file_handle->SetOffset(this->lz_enc_file_offset, Position::Begin));
+                NTR_R_TRY(this->file_handle->Read(this->lz_enc_buf + left_size, fill_size, read_size));
+                if(read_size == 0) {
+                    NTR_R_FAIL(ResultUnexpectedReadSize);
+                }
+                this->lz_enc_buf_size += read_size;
+                this->lz_enc_file_offset += read_size;
+            }
+        }
+
+        if(this->lz_index && (this->lz_dec->GetDecompressedOffset() == this->lz_index->GetNextCheckpointOffset())) {
+            const util::LzCheckpoint checkpoint = {
+                .enc_offset = this->lz_enc_file_offset - (this->lz_enc_buf_size - this->lz_enc_buf_offset),
+                .dec = *this->lz_dec
+            };
+            this->lz_index->checkpoints.push_back(checkpoint);
+        }
+
+        NTR_R_SUCCEED();
+    }
+
+    Result BinaryFile::ReadStreamedData(void *read_buf, const size_t read_size, size_t &out_read_size) {
+        if(this->dec_file_offset >= this->dec_file_size) {
+            NTR_R_FAIL(ResultEndOfData);
+        }
+
+        const auto actual_read_size = std::min(read_size, this->dec_file_size - this->dec_file_offset);
+        auto out_buf = reinterpret_cast<u8*>(read_buf);
+        size_t done_size = 0;
+
+        // Data right before the decompressor's position can still be found in its window...
+        const auto cur_dec_offset = this->lz_dec->GetDecompressedOffset();
+        if((this->dec_file_offset < cur_dec_offset) && this->lz_dec->IsInWindow(this->dec_file_offset)) {
+            done_size = std::min(actual_read_size, cur_dec_offset - this->dec_file_offset);
+            NTR_R_TRY(this->lz_dec->CopyFromWindow(this->dec_file_offset, out_buf, done_size));
+            this->dec_file_offset += done_size;
+        }
+        else {
+            // ...otherwise jump to the nearest checkpoint if it gets us closer, or start over if we are already past our position
+            const auto checkpoint = this->lz_index ? this->lz_index->FindNearest(this->dec_file_offset) : nullptr;
+            if((checkpoint != nullptr) && ((this->dec_file_offset < cur_dec_offset) || (checkpoint->dec.GetDecompressedOffset() > cur_dec_offset))) {
+                NTR_R_TRY(this->ResumeStreamedDecompression(*checkpoint));
+            }
+            else if(this->dec_file_offset < cur_dec_offset) {
+                NTR_R_TRY(this->StartStreamedDecompression());
+            }
+        }
+
+        // Skip (decompress and discard) anything between the decompressor's position and ours
+        u8 skip_buf[0x200];
+        while(this->lz_dec->GetDecompressedOffset() < this->dec_file_offset) {
+            const auto skip_size = std::min(sizeof(skip_buf), this->dec_file_offset - this->lz_dec->GetDecompressedOffset());
+            size_t skipped_size;
+            NTR_R_TRY(this->DecompressStreamedData(skip_buf, skip_size, skipped_size));
+        }
+
+        while(done_size < actual_read_size) {
+            size_t dec_size;
+            NTR_R_TRY(this->DecompressStreamedData(out_buf + done_size, actual_read_size - done_size, dec_size));
+            done_size += dec_size;
+            this->dec_file_offset += dec_size;
+        }
+
+        out_read_size = done_size;
+        NTR_R_SUCCEED();
+    }
+
+    void BinaryFile::DisposeStreamedDecompression() {
+        delete this->lz_dec;
+        this->lz_dec = nullptr;
+        delete[] this->lz_enc_buf;
+        this->lz_enc_buf = nullptr;
+        this->lz_enc_buf_offset = 0;
+        this->lz_enc_buf_size = 0;
+        this->lz_enc_file_offset = 0;
+        this->lz_enc_file_size = 0;
+        this->lz_index.reset();
+    }
+
     Result BinaryFile::Open(std::shared_ptr<FileHandle> file_handle, const std::string &path, const OpenMode mode, const FileCompression comp) {
         this->Close();
 
+        // A pending file needs its actual data before being used again
+        if(IsDeferredCompressionPending(path)) {
+            NTR_R_TRY(FlushDeferredCompression());
+        }
+
         this->file_handle = file_handle;
+        this->path = path;
         this->mode = mode;
         this->comp = comp;
+        this->ra_window_valid = false;
+        this->ra_hit_count = 0;
+        this->ra_miss_count = 0;
+
+        // Compressed files are either read from a decompressed image or written to a new one, never both
+        if(this->IsCompressed() && CanReadWithMode(mode) && CanWriteWithMode(mode)) {
+            NTR_R_FAIL(ResultInvalidFileOpenMode);
+        }
+
+        if(CanWriteWithMode(mode)) {
+            InvalidateDecompressedImageCache(path);
+        }
 
-        NTR_R_TRY(this->file_handle->Open(path, mode));
+        // Deferred files are only opened (and thus truncated) once their compressed data is written back
+        this->comp_deferred = g_DeferredCompressionEnabled && this->comp_deferrable && (comp == FileCompression::LZ77) && (mode == OpenMode::Write);
+        if(!this->comp_deferred) {
+            NTR_R_TRY(this->file_handle->Open(path, mode));
+        }
         
         if(this->IsCompressed()) {
-            NTR_R_TRY(this->LoadDecompressedData());
+            NTR_R_TRY(this->LoadDecompressedData(path));
         }
 
         this->ok = true;
@@ -180,21 +851,44 @@ namespace ntr::fs {
     }
 
     Result BinaryFile::Close() {
+        this->ra_window_valid = false;
+        delete[] this->ra_buf;
+        this->ra_buf = nullptr;
+        delete[] this->span_buf;
+        this->span_buf = nullptr;
+        this->span_buf_size = 0;
+        this->DisposeStreamedDecompression();
+
         if(this->IsValid()) {
             if(this->IsCompressed()) {
                 ScopeGuard on_exit_cleanup([&]() {
-                    delete[] this->dec_file_data;
+                    this->dec_file_data.reset();
+                    this->dec_file_chunks.Clear();
                 });
 
                 if(this->CanWrite()) {
-                    NTR_R_TRY(this->SaveCompressedData());
+                    if(this->comp_deferred) {
+                        NTR_R_TRY(this->DeferCompressedData());
+                    }
+                    else {
+                        NTR_R_TRY(this->SaveCompressedData());
+                    }
                 }
 
                 this->comp = FileCompression::None;
             }
 
             this->ok = false;
-            NTR_R_TRY(this->file_handle->Close());
+            if(this->comp_deferred) {
+                this->comp_deferred = false;
+            }
+            else {
+                NTR_R_TRY(this->file_handle->Close());
+            }
+
+            if(g_DeferredCompressionSize > g_DeferredCompressionMemoryBudget) {
+                NTR_R_TRY(FlushDeferredCompression());
+            }
             NTR_R_SUCCEED();
         }
         else {
@@ -203,14 +897,90 @@ namespace ntr::fs {
     }
 
     Result BinaryFile::CopyFrom(BinaryFile &other_bf, const size_t size) {
-        auto copy_buf = util::NewArray<u8>(CopyBufferSize);
+        if(!other_bf.IsValid()) {
+            NTR_R_FAIL(ResultInvalidFile);
+        }
+        if(!other_bf.CanRead()) {
+            NTR_R_FAIL(ResultReadNotSupported);
+        }
+        if(size == 0) {
+            NTR_R_SUCCEED();
+        }
+
+        if(other_bf.HasDecompressedData()) {
+            // The source is already in memory, so write straight from there
+            if((other_bf.dec_file_offset > other_bf.dec_file_size) || (size > (other_bf.dec_file_size - other_bf.dec_file_offset))) {
+                NTR_R_FAIL(ResultEndOfData);
+            }
+
+            NTR_R_TRY(this->WriteData(other_bf.dec_file_data.get() + other_bf.dec_file_offset, size));
+            other_bf.dec_file_offset += size;
+            NTR_R_SUCCEED();
+        }
+
+        auto cur_left_size = size;
+
+        #ifdef NTR_HOST_BUILD
+        // Between plain native files, let the OS copy as much as it can by itself
+        int in_fd;
+        int out_fd;
+        if(this->IsValid() && this->CanWrite() && !this->IsCompressed() && !other_bf.IsCompressed() && other_bf.file_handle->GetNativeFileDescriptor(in_fd) && this->file_handle->GetNativeFileDescriptor(out_fd)) {
+            size_t in_offset;
+            NTR_R_TRY(other_bf.GetAbsoluteOffset(in_offset));
+            size_t out_offset;
+            NTR_R_TRY(this->GetAbsoluteOffset(out_offset));
+
+            size_t copied_size;
+            NTR_R_TRY(CopyNativeFileData(in_fd, in_offset, out_fd, out_offset, size, copied_size));
+            NTR_R_TRY(other_bf.SetAbsoluteOffset(in_offset + copied_size));
+            NTR_R_TRY(this->SetAbsoluteOffset(out_offset + copied_size));
+            cur_left_size -= copied_size;
+        }
+        #endif
+
+        if(cur_left_size == 0) {
+            NTR_R_SUCCEED();
+        }
+
+        #ifdef NTR_HOST_BUILD
+        // Both sides must end up in different files, since each is only used by one thread
+        const auto depth = g_PipelinedCopyDepth;
+        const auto chunk_size = g_PipelinedCopyChunkSize;
+        const auto can_pipeline = [&]() {
+            const auto in_root_handle = GetExclusiveRootFileHandle(other_bf.file_handle, other_bf.path);
+            const auto out_root_handle = GetExclusiveRootFileHandle(this->file_handle, this->path);
+            return (in_root_handle != nullptr) && (out_root_handle != nullptr) && (in_root_handle != out_root_handle);
+        };
+        if((depth >= 2) && (chunk_size > 0) && (cur_left_size > chunk_size) && can_pipeline()) {
+            std::vector<u8*> chunk_bufs;
+            ScopeGuard on_exit_cleanup([&]() {
+                for(auto &chunk_buf : chunk_bufs) {
+                    delete[] chunk_buf;
+                }
+            });
+
+            for(size_t i = 0; i < depth; i++) {
+                auto chunk_buf = util::NewArray<u8>(chunk_size);
+                if(chunk_buf == nullptr) {
+                    break;
+                }
+                chunk_bufs.push_back(chunk_buf);
+            }
+
+            // Without enough memory for the ring, just copy sequentially
+            if(chunk_bufs.size() == depth) {
+                return PipelinedCopy(other_bf, *this, cur_left_size, chunk_bufs.data(), depth, chunk_size);
+            }
+        }
+        #endif
+
+        auto copy_buf = AcquireCopyBuffer();
         ScopeGuard on_exit_cleanup([&]() {
-            delete[] copy_buf;
+            ReleaseCopyBuffer(copy_buf);
         });
 
-        auto cur_left_size = size;
         while(cur_left_size > 0) {
-            const auto cur_copy_size = std::min(CopyBufferSize, cur_left_size);
+            const auto cur_copy_size = std::min(PooledCopyBufferSize, cur_left_size);
             size_t read_size;
             NTR_R_TRY(other_bf.ReadData(copy_buf, cur_copy_size, read_size));
             NTR_R_TRY(this->WriteData(copy_buf, read_size));
@@ -231,24 +1001,100 @@ namespace ntr::fs {
             NTR_R_SUCCEED();
         }
 
-        if(this->IsCompressed()) {
-            if(offset > this->dec_file_buf_size) {
-                if(!this->CanWrite()) {
-                    NTR_R_FAIL(ResultWriteNotSupported);
-                }
-                NTR_R_TRY(this->ReallocateDecompressedData(offset));
+        if(this->IsDecompressionStreamed()) {
+            // Decompression only happens once something is actually read
+            if(offset > this->dec_file_size) {
+                NTR_R_FAIL(ResultEndOfData);
             }
             this->dec_file_offset = offset;
+            NTR_R_SUCCEED();
+        }
+        else if(this->IsCompressed()) {
             if(offset > this->dec_file_size) {
-                this->dec_file_size = offset;
+                NTR_R_TRY(this->ResizeDecompressedData(offset));
             }
+            this->dec_file_offset = offset;
+            NTR_R_SUCCEED();
+        }
+        else if(this->IsInReadAheadWindow(offset)) {
+            this->ra_cur_offset = offset;
             NTR_R_SUCCEED();
         }
         else {
+            this->ra_window_valid = false;
             return this->file_handle->SetOffset(offset, Position::Begin);
         }
     }
 
+    Result BinaryFile::GetView(const size_t offset, const size_t size, std::shared_ptr<u8> &out_view) {
+        if(!this->IsValid()) {
+            NTR_R_FAIL(ResultInvalidFile);
+        }
+        if(!this->CanRead()) {
+            NTR_R_FAIL(ResultReadNotSupported);
+        }
+
+        if(this->IsDecompressionStreamed()) {
+            NTR_R_FAIL(ResultViewNotSupported);
+        }
+        else if(this->IsCompressed()) {
+            // Since the file is read-only, the decompressed data will never be reallocated
+            if((offset > this->dec_file_size) || (size > (this->dec_file_size - offset))) {
+                NTR_R_FAIL(ResultEndOfData);
+            }
+
+            out_view = std::shared_ptr<u8>(this->dec_file_data, this->dec_file_data.get() + offset);
+            NTR_R_SUCCEED();
+        }
+        else {
+            return this->file_handle->GetView(offset, size, out_view);
+        }
+    }
+
+    Result BinaryFile::ReadSpan(const size_t size, const u8 *&out_span) {
+        if(!this->IsValid()) {
+            NTR_R_FAIL(ResultInvalidFile);
+        }
+        if(!this->CanRead()) {
+            NTR_R_FAIL(ResultReadNotSupported);
+        }
+        if(size == 0) {
+            out_span = nullptr;
+            NTR_R_SUCCEED();
+        }
+
+        if(this->HasDecompressedData()) {
+            if(this->dec_file_offset >= this->dec_file_size) {
+                NTR_R_FAIL(ResultEndOfData);
+            }
+            if(size > (this->dec_file_size - this->dec_file_offset)) {
+                NTR_R_FAIL(ResultUnexpectedReadSize);
+            }
+
+            out_span = this->dec_file_data.get() + this->dec_file_offset;
+            this->dec_file_offset += size;
+            NTR_R_SUCCEED();
+        }
+
+        if(this->ra_window_valid && ((this->ra_cur_offset + size) <= (this->ra_window_offset + this->ra_window_size))) {
+            out_span = this->ra_buf + (this->ra_cur_offset - this->ra_window_offset);
+            this->ra_cur_offset += size;
+            this->ra_hit_count++;
+            NTR_R_SUCCEED();
+        }
+
+        // Fallback, copy into our own buffer
+        if(size > this->span_buf_size) {
+            delete[] this->span_buf;
+            this->span_buf = util::NewArray<u8>(size);
+            this->span_buf_size = size;
+        }
+
+        NTR_R_TRY(this->ReadDataExact(this->span_buf, size));
+        out_span = this->span_buf;
+        NTR_R_SUCCEED();
+    }
+
     Result BinaryFile::ReadData(void *read_buf, const size_t read_size, size_t &out_read_size) {
         if(!this->IsValid()) {
             NTR_R_FAIL(ResultInvalidFile);
@@ -260,9 +1106,15 @@ namespace ntr::fs {
             NTR_R_SUCCEED();
         }
 
-        if(this->IsCompressed()) {
+        if(this->IsDecompressionStreamed()) {
+            return this->ReadStreamedData(read_buf, read_size, out_read_size);
+        }
+        else if(this->IsCompressed()) {
             return this->ReadDecompressedData(read_buf, read_size, out_read_size);
         }
+        else if(this->ra_buf_size > 0) {
+            return this->ReadBufferedData(read_buf, read_size, out_read_size);
+        }
         else {
             return this->file_handle->Read(read_buf, read_size, out_read_size);
         }
@@ -283,8 +1135,92 @@ namespace ntr::fs {
             return this->WriteDecompressedData(write_buf, write_size);
         }
         else {
+            NTR_R_TRY(this->SyncReadAheadWindow());
             return this->file_handle->Write(write_buf, write_size);
         }
     }
 
-}
\ No newline at end of file
+    Result BinaryFile::ReadV(const ReadSegment *segments, const size_t segment_count, size_t &out_read_size) {
+        if(!this->IsValid()) {
+            NTR_R_FAIL(ResultInvalidFile);
+        }
+        if(!this->CanRead()) {
+            NTR_R_FAIL(ResultReadNotSupported);
+        }
+
+        if(this->IsCompressed() || (this->ra_buf_size > 0)) {
+            // Already in memory (or small enough to benefit from the read-ahead window), just read each segment
+            out_read_size = 0;
+            for(size_t i = 0; i < segment_count; i++) {
+                const auto &segment = segments[i];
+                if(segment.size == 0) {
+                    continue;
+                }
+
+                size_t read_size;
+                const auto rc = this->ReadData(segment.buf, segment.size, read_size);
+                if(rc.IsFailure()) {
+                    if(out_read_size == 0) {
+                        return rc;
+                    }
+                    break;
+                }
+
+                out_read_size += read_size;
+                if(read_size < segment.size) {
+                    break;
+                }
+            }
+
+            NTR_R_SUCCEED();
+        }
+        else {
+            return this->file_handle->ReadV(segments, segment_count, out_read_size);
+        }
+    }
+
+    Result BinaryFile::WriteV(const WriteSegment *segments, const size_t segment_count) {
+        if(!this->IsValid()) {
+            NTR_R_FAIL(ResultInvalidFile);
+        }
+        if(!this->CanWrite()) {
+            NTR_R_FAIL(ResultWriteNotSupported);
+        }
+
+        if(this->IsCompressed()) {
+            for(size_t i = 0; i < segment_count; i++) {
+                const auto &segment = segments[i];
+                if(segment.size > 0) {
+                    NTR_R_TRY(this->WriteDecompressedData(segment.buf, segment.size));
+                }
+            }
+
+            NTR_R_SUCCEED();
+        }
+        else {
+            NTR_R_TRY(this->SyncReadAheadWindow());
+            return this->file_handle->WriteV(segments, segment_count);
+        }
+    }
+
+    Result BinaryFile::WriteFill(const u8 value, const size_t count) {
+        if(!this->IsValid()) {
+            NTR_R_FAIL(ResultInvalidFile);
+        }
+        if(!this->CanWrite()) {
+            NTR_R_FAIL(ResultWriteNotSupported);
+        }
+        if(count == 0) {
+            NTR_R_SUCCEED();
+        }
+
+        if(this->IsCompressed()) {
+            return this->FillDecompressedData(value, count);
+        }
+        else {
+            NTR_R_TRY(this->SyncReadAheadWindow());
+            return this->file_handle->WriteFill(value, count);
+        }
+    }
+
+}
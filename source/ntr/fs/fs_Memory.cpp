@@ -0,0 +1,164 @@
+#include <ntr/fs/fs_Memory.hpp>
+
+namespace ntr::fs {
+
+    Result MemoryFileHandle::Reserve(const size_t new_buf_size) {
+        if(new_buf_size <= this->buf_size) {
+            NTR_R_SUCCEED();
+        }
+        if(!this->can_grow) {
+            NTR_R_FAIL(ResultUnableToGrowMemoryFile);
+        }
+
+        // Grow by half at least, so that many small writes don't move the data every time
+        const auto grow_buf_size = util::AlignUp(std::max(new_buf_size, this->buf_size + this->buf_size / 2), ReallocBufferSize);
+        auto new_buf = util::NewArray<u8>(grow_buf_size);
+        if(new_buf == nullptr) {
+            NTR_R_FAIL(ResultUnableToGrowMemoryFile);
+        }
+
+        if(this->size > 0) {
+            std::memcpy(new_buf, this->buf.get(), this->size);
+        }
+        this->buf = std::shared_ptr<u8>(new_buf, std::default_delete<u8[]>());
+        this->buf_size = grow_buf_size;
+        NTR_R_SUCCEED();
+    }
+
+    Result MemoryFileHandle::Resize(const size_t new_size) {
+        if(new_size > this->size) {
+            NTR_R_TRY(this->Reserve(new_size));
+
+            // Adopted buffers might have anything past the data
+            std::memset(this->buf.get() + this->size, 0, new_size - this->size);
+        }
+
+        this->size = new_size;
+        NTR_R_SUCCEED();
+    }
+
+    bool MemoryFileHandle::Exists(const std::string &path, size_t &out_size) {
+        out_size = this->size;
+        return true;
+    }
+
+    Result MemoryFileHandle::Open(const std::string &path, const OpenMode mode) {
+        switch(mode) {
+            case OpenMode::Write: {
+                this->size = 0;
+                this->offset = 0;
+                break;
+            }
+            case OpenMode::Update: {
+                this->offset = this->size;
+                break;
+            }
+            default: {
+                this->offset = 0;
+                break;
+            }
+        }
+
+        NTR_R_SUCCEED();
+    }
+
+    Result MemoryFileHandle::GetSize(size_t &out_size) {
+        out_size = this->size;
+        NTR_R_SUCCEED();
+    }
+
+    Result MemoryFileHandle::SetOffset(const size_t offset, const Position pos) {
+        switch(pos) {
+            case Position::Begin: {
+                this->offset = offset;
+                break;
+            }
+            case Position::Current: {
+                this->offset += offset;
+                break;
+            }
+            default: {
+                NTR_R_FAIL(ResultInvalidSeekPosition);
+            }
+        }
+
+        NTR_R_SUCCEED();
+    }
+
+    Result MemoryFileHandle::GetOffset(size_t &out_offset) {
+        out_offset = this->offset;
+        NTR_R_SUCCEED();
+    }
+
+    Result MemoryFileHandle::Read(void *read_buf, const size_t read_size, size_t &out_read_size) {
+        if(this->offset >= this->size) {
+            NTR_R_FAIL(ResultEndOfData);
+        }
+
+        const auto actual_read_size = std::min(read_size, this->size - this->offset);
+        std::memcpy(read_buf, this->buf.get() + this->offset, actual_read_size);
+        this->offset += actual_read_size;
+        out_read_size = actual_read_size;
+        NTR_R_SUCCEED();
+    }
+
+    Result MemoryFileHandle::Write(const void *write_buf, const size_t write_size) {
+        const auto end_offset = this->offset + write_size;
+        if(end_offset > this->size) {
+            NTR_R_TRY(this->Resize(end_offset));
+        }
+
+        std::memcpy(this->buf.get() + this->offset, write_buf, write_size);
+        this->offset = end_offset;
+        NTR_R_SUCCEED();
+    }
+
+    Result MemoryFileHandle::Close() {
+        // The data stays, only the offset is reset
+        this->offset = 0;
+        NTR_R_SUCCEED();
+    }
+
+    Result MemoryFileHandle::WriteV(const WriteSegment *segments, const size_t segment_count) {
+        // Grow at most once for all the segments
+        auto end_offset = this->offset;
+        for(size_t i = 0; i < segment_count; i++) {
+            end_offset += segments[i].size;
+        }
+        if(end_offset > this->size) {
+            NTR_R_TRY(this->Resize(end_offset));
+        }
+
+        for(size_t i = 0; i < segment_count; i++) {
+            const auto &segment = segments[i];
+            if(segment.size > 0) {
+                std::memcpy(this->buf.get() + this->offset, segment.buf, segment.size);
+                this->offset += segment.size;
+            }
+        }
+
+        NTR_R_SUCCEED();
+    }
+
+    Result MemoryFileHandle::WriteFill(const u8 value, const size_t count) {
+        const auto end_offset = this->offset + count;
+        if(end_offset > this->size) {
+            NTR_R_TRY(this->Resize(end_offset));
+        }
+
+        std::memset(this->buf.get() + this->offset, value, count);
+        this->offset = end_offset;
+        NTR_R_SUCCEED();
+    }
+
+    Result MemoryFileHandle::GetView(const size_t offset, const size_t size, std::shared_ptr<u8> &out_view) {
+        if((offset > this->size) || (size > (this->size - offset))) {
+            NTR_R_FAIL(ResultEndOfData);
+        }
+
+        // Views keep the current buffer alive even if the file moves to a bigger one later
+        out_view = std::shared_ptr<u8>(this->buf, this->buf.get() + offset);
+        NTR_R_SUCCEED();
+    }
+
+}
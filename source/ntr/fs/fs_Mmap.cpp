@@ -0,0 +1,116 @@
+#include <ntr/fs/fs_Mmap.hpp>
+
+#ifdef NTR_HOST_BUILD
+
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace ntr::fs {
+
+    bool MmapFileHandle::Exists(const std::string &path, size_t &out_size) {
+        return GetStdioFileSize(path, out_size).IsSuccess();
+    }
+
+    Result MmapFileHandle::Open(const std::string &path, const OpenMode mode) {
+        if(mode != OpenMode::Read) {
+            NTR_R_FAIL(ResultInvalidFileOpenMode);
+        }
+
+        const auto fd = open(path.c_str(), O_RDONLY);
+        if(fd < 0) {
+            NTR_R_FAIL(ResultUnableToOpenStdioFile);
+        }
+        ScopeGuard on_exit_cleanup([&]() {
+            close(fd);
+        });
+
+        struct stat st;
+        if(fstat(fd, &st) != 0) {
+            NTR_R_FAIL(ResultUnableToOpenStdioFile);
+        }
+
+        this->map.reset();
+        this->map_size = st.st_size;
+        this->offset = 0;
+
+        // Empty files cannot be mapped, but they are still valid (empty) files
+        if(this->map_size > 0) {
+            auto map_ptr = mmap(nullptr, this->map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if(map_ptr == MAP_FAILED) {
+                NTR_R_FAIL(ResultUnableToMapStdioFile);
+            }
+
+            const auto map_size = this->map_size;
+            this->map = std::shared_ptr<u8>(reinterpret_cast<u8*>(map_ptr), [map_size](u8 *ptr) {
+                munmap(ptr, map_size);
+            });
+        }
+
+        NTR_R_SUCCEED();
+    }
+
+    Result MmapFileHandle::GetSize(size_t &out_size) {
+        out_size = this->map_size;
+        NTR_R_SUCCEED();
+    }
+
+    Result MmapFileHandle::SetOffset(const size_t offset, const Position pos) {
+        switch(pos) {
+            case Position::Begin: {
+                this->offset = offset;
+                break;
+            }
+            case Position::Current: {
+                this->offset += offset;
+                break;
+            }
+            default: {
+                NTR_R_FAIL(ResultInvalidSeekPosition);
+            }
+        }
+
+        NTR_R_SUCCEED();
+    }
+
+    Result MmapFileHandle::GetOffset(size_t &out_offset) {
+        out_offset = this->offset;
+        NTR_R_SUCCEED();
+    }
+
+    Result MmapFileHandle::Read(void *read_buf, const size_t read_size, size_t &out_read_size) {
+        if(this->offset >= this->map_size) {
+            NTR_R_FAIL(ResultEndOfData);
+        }
+
+        const auto actual_read_size = std::min(read_size, this->map_size - this->offset);
+        std::memcpy(read_buf, this->map.get() + this->offset, actual_read_size);
+        this->offset += actual_read_size;
+        out_read_size = actual_read_size;
+        NTR_R_SUCCEED();
+    }
+
+    Result MmapFileHandle::Write(const void *write_buf, const size_t write_size) {
+        NTR_R_FAIL(ResultWriteNotSupported);
+    }
+
+    Result MmapFileHandle::Close() {
+        // Any views lent out keep the mapping alive by themselves
+        this->map.reset();
+        this->map_size = 0;
+        this->offset = 0;
+        NTR_R_SUCCEED();
+    }
+
+    Result MmapFileHandle::GetView(const size_t offset, const size_t size, std::shared_ptr<u8> &out_view) {
+        if((offset > this->map_size) || (size > (this->map_size - offset))) {
+            NTR_R_FAIL(ResultEndOfData);
+        }
+
+        out_view = std::shared_ptr<u8>(this->map, this->map.get() + offset);
+        NTR_R_SUCCEED();
+    }
+
+}
+
+#endif
@@ -1,10 +1,39 @@
 #include <ntr/fs/fs_Stdio.hpp>
 #include <unistd.h>
+#include <fcntl.h>
+#ifdef NTR_HOST_BUILD
+#include <sys/uio.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+#endif
 
 namespace ntr::fs {
 
     namespace {
 
+        CommitSyncMode g_CommitSyncMode = CommitSyncMode::FileAndDirectory;
+
+        inline constexpr int GetOpenFlags(const OpenMode mode) {
+            switch(mode) {
+                case OpenMode::Read: {
+                    return O_RDONLY;
+                }
+                case OpenMode::Write: {
+                    return O_WRONLY | O_CREAT | O_TRUNC;
+                }
+                case OpenMode::Update: {
+                    return O_WRONLY | O_CREAT;
+                }
+                case OpenMode::ReadWrite: {
+                    return O_RDWR;
+                }
+                default: {
+                    return -1;
+                }
+            }
+        }
+
         inline constexpr const char *GetOpenMode(const OpenMode mode) {
             switch(mode) {
                 case OpenMode::Read: {
@@ -16,6 +45,9 @@ namespace ntr::fs {
                 case OpenMode::Update: {
                     return "ab";
                 }
+                case OpenMode::ReadWrite: {
+                    return "r+b";
+                }
                 default: {
                     return nullptr;
                 }
@@ -42,6 +74,7 @@ namespace ntr::fs {
         }
 
         this->file = fopen(path.c_str(), f_mode);
+        this->last_access = Access::None;
         if(this->file == nullptr) {
             NTR_R_FAIL(ResultUnableToOpenStdioFile);
         }
@@ -80,6 +113,7 @@ namespace ntr::fs {
             }
         }
 
+        this->last_access = Access::None;
         if(fseek(this->file, offset, whence) != 0) {
             NTR_R_FAIL(ResultUnableToSeekStdioFile);
         }
@@ -93,7 +127,20 @@ namespace ntr::fs {
         NTR_R_SUCCEED();
     }
 
+    Result StdioFileHandle::SwitchAccess(const Access access) {
+        // stdio requires a seek between reading and writing the same stream (only possible with ReadWrite mode)
+        if((this->last_access != Access::None) && (this->last_access != access)) {
+            if(fseek(this->file, 0, SEEK_CUR) != 0) {
+                NTR_R_FAIL(ResultUnableToSeekStdioFile);
+            }
+        }
+
+        this->last_access = access;
+        NTR_R_SUCCEED();
+    }
+
     Result StdioFileHandle::Read(void *read_buf, const size_t read_size, size_t &out_read_size) {
+        NTR_R_TRY(this->SwitchAccess(Access::Read));
         const auto got_read_size = fread(read_buf, 1, read_size, this->file);
         if(got_read_size == 0) {
             NTR_R_FAIL(ResultUnableToReadStdioFile);
@@ -105,6 +152,7 @@ namespace ntr::fs {
     }
 
     Result StdioFileHandle::Write(const void *write_buf, const size_t write_size) {
+        NTR_R_TRY(this->SwitchAccess(Access::Write));
         if(fwrite(write_buf, write_size, 1, this->file) != 1) {
             NTR_R_FAIL(ResultUnableToWriteStdioFile);
         }
@@ -113,6 +161,10 @@ namespace ntr::fs {
         }
     }
 
+    Result StdioFileHandle::ReplaceFile(const std::string &path, const std::string &new_stdio_path) {
+        return ReplaceStdioFile(path, new_stdio_path);
+    }
+
     Result StdioFileHandle::Close() {
         if(this->file == nullptr) {
             NTR_R_FAIL(ResultInvalidFile);
@@ -128,6 +180,385 @@ namespace ntr::fs {
         }
     }
 
+    #ifdef NTR_HOST_BUILD
+
+    Result StdioFileHandle::WriteFill(const u8 value, const size_t count) {
+        NTR_R_TRY(this->SwitchAccess(Access::Write));
+
+        // Zeros at (or past) the end of the file don't need to be written: extending the file reads them back anyway
+        int fd;
+        if((value == 0) && (count > 0) && this->GetNativeFileDescriptor(fd)) {
+            const auto cur_offset = ftell(this->file);
+            struct stat st;
+            if((cur_offset >= 0) && (fstat(fd, &st) == 0) && (static_cast<size_t>(cur_offset) >= static_cast<size_t>(st.st_size))) {
+                const auto new_size = cur_offset + count;
+                if(ftruncate(fd, new_size) != 0) {
+                    NTR_R_FAIL(ResultUnableToWriteStdioFile);
+                }
+                if(fseek(this->file, new_size, SEEK_SET) != 0) {
+                    NTR_R_FAIL(ResultUnableToWriteStdioFile);
+                }
+
+                this->last_access = Access::None;
+                NTR_R_SUCCEED();
+            }
+        }
+
+        return FileHandle::WriteFill(value, count);
+    }
+
+    bool StdioFileHandle::GetNativeFileDescriptor(int &out_fd) {
+        if(this->file == nullptr) {
+            return false;
+        }
+
+        // Anything buffered must reach the file before the OS touches it behind our back
+        if(fflush(this->file) != 0) {
+            return false;
+        }
+
+        out_fd = fileno(this->file);
+        return out_fd >= 0;
+    }
+
+    bool PositionalStdioFileHandle::Exists(const std::string &path, size_t &out_size) {
+        return GetStdioFileSize(path, out_size).IsSuccess();
+    }
+
+    Result PositionalStdioFileHandle::Open(const std::string &path, const OpenMode mode) {
+        const auto flags = GetOpenFlags(mode);
+        if(flags == -1) {
+            NTR_R_FAIL(ResultInvalidFileOpenMode);
+        }
+
+        // Handles may be opened again without being closed (like shared root handles of subranges)
+        if(this->fd >= 0) {
+            close(this->fd);
+            this->fd = -1;
+        }
+
+        this->fd = open(path.c_str(), flags, 0666);
+        if(this->fd < 0) {
+            NTR_R_FAIL(ResultUnableToOpenStdioFile);
+        }
+
+        struct stat st;
+        if(fstat(this->fd, &st) != 0) {
+            close(this->fd);
+            this->fd = -1;
+            NTR_R_FAIL(ResultUnableToOpenStdioFile);
+        }
+        this->size = st.st_size;
+        this->size_outdated = false;
+
+        // Like appending with stdio, updating starts at the end of the file
+        this->offset = (mode == OpenMode::Update) ? this->size : 0;
+        NTR_R_SUCCEED();
+    }
+
+    Result PositionalStdioFileHandle::GetSize(size_t &out_size) {
+        if(this->size_outdated) {
+            struct stat st;
+            if(fstat(this->fd, &st) != 0) {
+                NTR_R_FAIL(ResultUnableToReadStdioFile);
+            }
+
+            this->size = st.st_size;
+            this->size_outdated = false;
+        }
+
+        out_size = this->size;
+        NTR_R_SUCCEED();
+    }
+
+    Result PositionalStdioFileHandle::SetOffset(const size_t offset, const Position pos) {
+        switch(pos) {
+            case Position::Begin: {
+                this->offset = offset;
+                break;
+            }
+            case Position::Current: {
+                this->offset += offset;
+                break;
+            }
+            default: {
+                NTR_R_FAIL(ResultInvalidSeekPosition);
+            }
+        }
+
+        NTR_R_SUCCEED();
+    }
+
+    Result PositionalStdioFileHandle::GetOffset(size_t &out_offset) {
+        out_offset = this->offset;
+        NTR_R_SUCCEED();
+    }
+
+    Result PositionalStdioFileHandle::Read(void *read_buf, const size_t read_size, size_t &out_read_size) {
+        const auto got_read_size = pread(this->fd, read_buf, read_size, this->offset);
+        if(got_read_size <= 0) {
+            NTR_R_FAIL(ResultUnableToReadStdioFile);
+        }
+        else {
+            this->offset += got_read_size;
+            out_read_size = got_read_size;
+            NTR_R_SUCCEED();
+        }
+    }
+
+    Result PositionalStdioFileHandle::Write(const void *write_buf, const size_t write_size) {
+        auto cur_write_buf = reinterpret_cast<const u8*>(write_buf);
+        auto cur_left_size = write_size;
+        while(cur_left_size > 0) {
+            const auto written_size = pwrite(this->fd, cur_write_buf, cur_left_size, this->offset);
+            if(written_size <= 0) {
+                NTR_R_FAIL(ResultUnableToWriteStdioFile);
+            }
+
+            cur_write_buf += written_size;
+            cur_left_size -= written_size;
+            this->offset += written_size;
+        }
+
+        if(this->offset > this->size) {
+            this->size = this->offset;
+        }
+        NTR_R_SUCCEED();
+    }
+
+    Result PositionalStdioFileHandle::ReadV(const ReadSegment *segments, const size_t segment_count, size_t &out_read_size) {
+        out_read_size = 0;
+
+        iovec iovs[IOV_MAX];
+        size_t segment_i = 0;
+        while(segment_i < segment_count) {
+            size_t iov_count = 0;
+            size_t iovs_size = 0;
+            while((segment_i < segment_count) && (iov_count < IOV_MAX)) {
+                const auto &segment = segments[segment_i];
+                iovs[iov_count].iov_base = segment.buf;
+                iovs[iov_count].iov_len = segment.size;
+                iovs_size += segment.size;
+                iov_count++;
+                segment_i++;
+            }
+
+            const auto got_read_size = preadv(this->fd, iovs, iov_count, this->offset);
+            if(got_read_size <= 0) {
+                if(out_read_size == 0) {
+                    NTR_R_FAIL(ResultUnableToReadStdioFile);
+                }
+                break;
+            }
+
+            this->offset += got_read_size;
+            out_read_size += got_read_size;
+            if(static_cast<size_t>(got_read_size) < iovs_size) {
+                // Reached the end of the file
+                break;
+            }
+        }
+
+        NTR_R_SUCCEED();
+    }
+
+    Result PositionalStdioFileHandle::WriteV(const WriteSegment *segments, const size_t segment_count) {
+        iovec iovs[IOV_MAX];
+        size_t segment_i = 0;
+        while(segment_i < segment_count) {
+            size_t iov_count = 0;
+            while((segment_i < segment_count) && (iov_count < IOV_MAX)) {
+                const auto &segment = segments[segment_i];
+                iovs[iov_count].iov_base = const_cast<void*>(segment.buf);
+                iovs[iov_count].iov_len = segment.size;
+                iov_count++;
+                segment_i++;
+            }
+
+            auto cur_iovs = iovs;
+            auto cur_iov_count = iov_count;
+            while(cur_iov_count > 0) {
+                const auto written_size = pwritev(this->fd, cur_iovs, cur_iov_count, this->offset);
+                if(written_size < 0) {
+                    NTR_R_FAIL(ResultUnableToWriteStdioFile);
+                }
+                this->offset += written_size;
+
+                // Skip whatever was fully written, then continue with any partially written segment
+                size_t left_written_size = written_size;
+                while((cur_iov_count > 0) && (left_written_size >= cur_iovs->iov_len)) {
+                    left_written_size -= cur_iovs->iov_len;
+                    cur_iovs++;
+                    cur_iov_count--;
+                }
+                if(cur_iov_count > 0) {
+                    if((written_size == 0) && (left_written_size == 0)) {
+                        NTR_R_FAIL(ResultUnableToWriteStdioFile);
+                    }
+                    cur_iovs->iov_base = reinterpret_cast<u8*>(cur_iovs->iov_base) + left_written_size;
+                    cur_iovs->iov_len -= left_written_size;
+                }
+            }
+        }
+
+        if(this->offset > this->size) {
+            this->size = this->offset;
+        }
+        NTR_R_SUCCEED();
+    }
+
+    Result PositionalStdioFileHandle::WriteFill(const u8 value, const size_t count) {
+        // Same as above: zeros at (or past) the end of the file are just a size extension
+        if((value == 0) && (count > 0)) {
+            size_t cur_size;
+            NTR_R_TRY(this->GetSize(cur_size));
+            if(this->offset >= cur_size) {
+                const auto new_size = this->offset + count;
+                if(ftruncate(this->fd, new_size) != 0) {
+                    NTR_R_FAIL(ResultUnableToWriteStdioFile);
+                }
+
+                this->offset = new_size;
+                this->size = new_size;
+                NTR_R_SUCCEED();
+            }
+        }
+
+        return FileHandle::WriteFill(value, count);
+    }
+
+    Result PositionalStdioFileHandle::ReplaceFile(const std::string &path, const std::string &new_stdio_path) {
+        return ReplaceStdioFile(path, new_stdio_path);
+    }
+
+    bool PositionalStdioFileHandle::GetNativeFileDescriptor(int &out_fd) {
+        if(this->fd < 0) {
+            return false;
+        }
+
+        // Whatever is done with the descriptor might change the file size
+        this->size_outdated = true;
+        out_fd = this->fd;
+        return true;
+    }
+
+    Result PositionalStdioFileHandle::Close() {
+        if(this->fd < 0) {
+            NTR_R_FAIL(ResultInvalidFile);
+        }
+
+        const auto cur_fd = this->fd;
+        this->fd = -1;
+        if(close(cur_fd) != 0) {
+            NTR_R_FAIL(ResultUnableToCloseStdioFile);
+        }
+        else {
+            NTR_R_SUCCEED();
+        }
+    }
+
+    Result CopyNativeFileData(const int in_fd, const size_t in_offset, const int out_fd, const size_t out_offset, const size_t size, size_t &out_copied_size) {
+        out_copied_size = 0;
+
+        #ifdef __linux__
+        // Try copy_file_range first (might even be done without copying anything, depending on the filesystem)...
+        loff_t cur_in_offset = in_offset;
+        loff_t cur_out_offset = out_offset;
+        while(out_copied_size < size) {
+            const auto copied_size = copy_file_range(in_fd, &cur_in_offset, out_fd, &cur_out_offset, size - out_copied_size, 0);
+            if(copied_size <= 0) {
+                break;
+            }
+
+            out_copied_size += copied_size;
+        }
+
+        // ...then sendfile, which only writes at the output descriptor's offset
+        if((out_copied_size < size) && (lseek(out_fd, out_offset + out_copied_size, SEEK_SET) >= 0)) {
+            off_t cur_sendfile_in_offset = in_offset + out_copied_size;
+            while(out_copied_size < size) {
+                const auto copied_size = sendfile(out_fd, in_fd, &cur_sendfile_in_offset, size - out_copied_size);
+                if(copied_size <= 0) {
+                    break;
+                }
+
+                out_copied_size += copied_size;
+            }
+        }
+        #endif
+
+        NTR_R_SUCCEED();
+    }
+
+    #endif
+
+    void SetCommitSyncMode(const CommitSyncMode mode) {
+        g_CommitSyncMode = mode;
+    }
+
+    Result ReplaceStdioFile(const std::string &path, const std::string &new_path) {
+        #ifdef NTR_HOST_BUILD
+        if(g_CommitSyncMode != CommitSyncMode::None) {
+            const auto fd = open(new_path.c_str(), O_RDONLY);
+            if(fd < 0) {
+                NTR_R_FAIL(ResultUnableToSyncStdioFile);
+            }
+
+            const auto sync_ok = fsync(fd) == 0;
+            close(fd);
+            if(!sync_ok) {
+                NTR_R_FAIL(ResultUnableToSyncStdioFile);
+            }
+        }
+        #endif
+
+        if(rename(new_path.c_str(), path.c_str()) != 0) {
+            NTR_R_FAIL(ResultUnableToReplaceStdioFile);
+        }
+
+        #ifdef NTR_HOST_BUILD
+        if(g_CommitSyncMode == CommitSyncMode::FileAndDirectory) {
+            // Note: intentionally not checking this since the file was already replaced (some filesystems can't even sync directories)
+            auto dir = GetBaseDirectory(path);
+            if(dir.empty()) {
+                dir = ".";
+            }
+
+            const auto dir_fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+            if(dir_fd >= 0) {
+                fsync(dir_fd);
+                close(dir_fd);
+            }
+        }
+        #endif
+
+        NTR_R_SUCCEED();
+    }
+
+    Result CommitStdioFile(std::shared_ptr<FileHandle> file_handle, const std::string &path, const std::string &new_path) {
+        // Anything cached from the old file is outdated either way
+        InvalidateDecompressedImageCache(path);
+
+        if(file_handle->ReplaceFile(path, new_path).IsSuccess()) {
+            NTR_R_SUCCEED();
+        }
+
+        {
+            fs::BinaryFile w_bf;
+            NTR_R_TRY(w_bf.Open(file_handle, path, fs::OpenMode::Write));
+
+            fs::BinaryFile r_bf;
+            NTR_R_TRY(r_bf.Open(std::make_shared<fs::StdioFileHandle>(), new_path, fs::OpenMode::Read));
+
+            size_t r_file_size;
+            NTR_R_TRY(r_bf.GetSize(r_file_size));
+            NTR_R_TRY(w_bf.CopyFrom(r_bf, r_file_size));
+        }
+
+        NTR_R_TRY(DeleteStdioFile(new_path));
+        NTR_R_SUCCEED();
+    }
+
     Result CreateStdioDirectory(const std::string &dir) {
         auto pos_init = 0;
         auto pos_found = 0;
@@ -144,7 +575,7 @@ namespace ntr::fs {
                 cur_dir += "/";
             }
             cur_dir += token;
-            if(mkdir(cur_dir.c_str(), 777) != 0) {
+            if(mkdir(cur_dir.c_str(), 0777) != 0) {
                 if(errno != EEXIST) {
                     NTR_R_FAIL(ResultUnableToCreateStdioDirectory);
                 }
@@ -222,35 +653,242 @@ namespace ntr::fs {
         NTR_R_SUCCEED();
     }
 
-    Result ListAllStdioFiles(const std::string &path, std::vector<std::string> &out_files) {
-        auto dir = opendir(path.c_str());
-        if(dir) {
-            std::vector<std::string> subdirs;
-            while(true) {
-                const auto ent = readdir(dir);
-                if(ent == nullptr) {
-                    break;
-                }
-                if(strcmp(ent->d_name, ".") == 0) {
-                    continue;
-                }
-                if(strcmp(ent->d_name, "..") == 0) {
-                    continue;
-                }
-                const auto subpath = path + "/" + ent->d_name;
-                if(ent->d_type & DT_DIR) {
-                    subdirs.push_back(subpath);
-                }
-                else if(ent->d_type & DT_REG) {
-                    out_files.push_back(subpath);
+    bool ChunkedBufferFileHandle::Exists(const std::string &path, size_t &out_size) {
+        out_size = this->buf->GetSize();
+        return true;
+    }
+
+    Result ChunkedBufferFileHandle::Open(const std::string &path, const OpenMode mode) {
+        switch(mode) {
+            case OpenMode::Write: {
+                this->buf->Resize(0);
+                this->offset = 0;
+                break;
+            }
+            case OpenMode::Update: {
+                this->offset = this->buf->GetSize();
+                break;
+            }
+            default: {
+                this->offset = 0;
+                break;
+            }
+        }
+
+        NTR_R_SUCCEED();
+    }
+
+    Result ChunkedBufferFileHandle::GetSize(size_t &out_size) {
+        out_size = this->buf->GetSize();
+        NTR_R_SUCCEED();
+    }
+
+    Result ChunkedBufferFileHandle::SetOffset(const size_t offset, const Position pos) {
+        switch(pos) {
+            case Position::Begin: {
+                this->offset = offset;
+                break;
+            }
+            case Position::Current: {
+                this->offset += offset;
+                break;
+            }
+            default: {
+                NTR_R_FAIL(ResultInvalidSeekPosition);
+            }
+        }
+
+        NTR_R_SUCCEED();
+    }
+
+    Result ChunkedBufferFileHandle::GetOffset(size_t &out_offset) {
+        out_offset = this->offset;
+        NTR_R_SUCCEED();
+    }
+
+    Result ChunkedBufferFileHandle::Read(void *read_buf, const size_t read_size, size_t &out_read_size) {
+        const auto buf_size = this->buf->GetSize();
+        if(this->offset >= buf_size) {
+            NTR_R_FAIL(ResultEndOfData);
+        }
+
+        const auto actual_read_size = std::min(read_size, buf_size - this->offset);
+        NTR_R_TRY(this->buf->Read(this->offset, read_buf, actual_read_size));
+        this->offset += actual_read_size;
+        out_read_size = actual_read_size;
+        NTR_R_SUCCEED();
+    }
+
+    Result ChunkedBufferFileHandle::Write(const void *write_buf, const size_t write_size) {
+        this->buf->Write(this->offset, write_buf, write_size);
+        this->offset += write_size;
+        NTR_R_SUCCEED();
+    }
+
+    Result ChunkedBufferFileHandle::WriteFill(const u8 value, const size_t count) {
+        this->buf->Fill(this->offset, value, count);
+        this->offset += count;
+        NTR_R_SUCCEED();
+    }
+
+    Result ChunkedBufferFileHandle::Close() {
+        NTR_R_SUCCEED();
+    }
+
+    Result OpenExternalFsFile(const ExternalFsFile &file, const OpenMode mode, BinaryFile &out_bf) {
+        if(file.IsInMemory()) {
+            return out_bf.Open(std::make_shared<ChunkedBufferFileHandle>(file.mem_data), file.ext_fs_path, mode);
+        }
+        else {
+            return out_bf.Open(std::make_shared<StdioFileHandle>(), file.ext_fs_path, mode);
+        }
+    }
+
+    Result SpillExternalFsFile(ExternalFsFile &file) {
+        if(!file.IsInMemory()) {
+            NTR_R_SUCCEED();
+        }
+
+        {
+            BinaryFile mem_bf;
+            NTR_R_TRY(OpenExternalFsFile(file, OpenMode::Read, mem_bf));
+
+            EnsureBaseStdioDirectoryExists(file.ext_fs_path);
+            BinaryFile bf;
+            NTR_R_TRY(bf.Open(std::make_shared<StdioFileHandle>(), file.ext_fs_path, OpenMode::Write));
+            NTR_R_TRY(bf.CopyFrom(mem_bf, file.mem_data->GetSize()));
+        }
+
+        file.mem_data.reset();
+        NTR_R_SUCCEED();
+    }
+
+    void SpillExternalFsFiles(ExternalFsFileFormat &ext_fs_file) {
+        auto mem_size = ext_fs_file.GetExternalFsMemorySize();
+        while(mem_size > ext_fs_file.ext_fs_mem_budget) {
+            // Opened files are still in use, so they aren't moved
+            ExternalFsFile *lru_file = nullptr;
+            for(auto &[path, staged_file] : ext_fs_file.ext_fs_files) {
+                if(staged_file.IsInMemory() && (staged_file.open_count == 0)) {
+                    if((lru_file == nullptr) || (staged_file.last_use < lru_file->last_use)) {
+                        lru_file = std::addressof(staged_file);
+                    }
                 }
             }
-            closedir(dir);
-            for(const auto &subdir : subdirs) {
-                NTR_R_TRY(ListAllStdioFiles(subdir, out_files));
+            if(lru_file == nullptr) {
+                break;
+            }
+
+            const auto file_mem_size = lru_file->mem_data->GetSize();
+            if(SpillExternalFsFile(*lru_file).IsFailure()) {
+                // Just keep it in memory then
+                break;
             }
+            mem_size -= file_mem_size;
         }
+    }
+
+    void DeleteExternalFsFile(const ExternalFsFile &file) {
+        if(!file.IsInMemory()) {
+            DeleteStdioFile(file.ext_fs_path);
+        }
+    }
+
+    StdioFileSystemIterator::StdioFileSystemIterator(const std::string &path, const bool recursive, Filter filter) : cur_path(path), cur_name_offset(path.length()), cur_is_file(false), cur_is_dir(false), cur_is_link(false), recursive(recursive), skip_cur_dir(false), filter(filter) {
+        this->PushDirectory(path.length());
+    }
+
+    StdioFileSystemIterator::~StdioFileSystemIterator() {
+        for(auto &state : this->dir_stack) {
+            closedir(state.dir);
+        }
+    }
+
+    void StdioFileSystemIterator::PushDirectory(const size_t path_len) {
+        this->cur_path.resize(path_len);
+        auto dir = opendir(this->cur_path.c_str());
+        if(dir) {
+            this->dir_stack.push_back({ dir, path_len });
+        }
+    }
+
+    bool StdioFileSystemIterator::LoadNextEntry() {
+        const auto &state = this->dir_stack.back();
+        while(true) {
+            const auto ent = readdir(state.dir);
+            if(ent == nullptr) {
+                return false;
+            }
+            if((ent->d_name[0] == '.') && ((ent->d_name[1] == '\0') || ((ent->d_name[1] == '.') && (ent->d_name[2] == '\0')))) {
+                continue;
+            }
+
+            this->cur_path.resize(state.path_len);
+            this->cur_path += '/';
+            this->cur_name_offset = this->cur_path.length();
+            this->cur_path += ent->d_name;
+
+            this->cur_is_link = ent->d_type == DT_LNK;
+            if(ent->d_type == DT_REG) {
+                this->cur_is_file = true;
+                this->cur_is_dir = false;
+            }
+            else if(ent->d_type == DT_DIR) {
+                this->cur_is_file = false;
+                this->cur_is_dir = true;
+            }
+            else if((ent->d_type == DT_UNKNOWN) || this->cur_is_link) {
+                // Some filesystems don't fill d_type (and links need to be resolved anyway)
+                struct stat st;
+                #ifdef NTR_HOST_BUILD
+                const auto stat_ok = fstatat(dirfd(state.dir), ent->d_name, &st, 0) == 0;
+                #else
+                const auto stat_ok = stat(this->cur_path.c_str(), &st) == 0;
+                #endif
+                this->cur_is_file = stat_ok && S_ISREG(st.st_mode);
+                this->cur_is_dir = stat_ok && S_ISDIR(st.st_mode);
+            }
+            else {
+                this->cur_is_file = false;
+                this->cur_is_dir = false;
+            }
+
+            return true;
+        }
+    }
+
+    bool StdioFileSystemIterator::Next() {
+        while(!this->dir_stack.empty()) {
+            // Walking into directories is delayed until here, so they can be skipped after being listed (links to directories are never walked, to avoid cycles)
+            if(this->recursive && this->cur_is_dir && !this->cur_is_link && !this->skip_cur_dir) {
+                this->cur_is_dir = false;
+                this->PushDirectory(this->cur_path.length());
+            }
+            this->skip_cur_dir = false;
+
+            if(!this->LoadNextEntry()) {
+                closedir(this->dir_stack.back().dir);
+                this->dir_stack.pop_back();
+                this->cur_is_file = false;
+                this->cur_is_dir = false;
+                continue;
+            }
+
+            if(!this->filter || this->filter(*this)) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    Result ListAllStdioFiles(const std::string &path, std::vector<std::string> &out_files) {
+        StdioFileSystemIterator it(path, true, IsStdioFileEntry);
+        while(it.Next()) {
+            out_files.push_back(it.GetEntryPath());
+        }
+
         NTR_R_SUCCEED();
     }
 
-}
\ No newline at end of file
+}
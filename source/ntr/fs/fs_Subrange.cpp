@@ -0,0 +1,116 @@
+#include <ntr/fs/fs_Subrange.hpp>
+
+namespace ntr::fs {
+
+    void SubrangeFileHandle::SetRange(std::shared_ptr<FileHandle> handle, const std::string &path, const size_t base_offset, const size_t size) {
+        this->root_handle = handle;
+        this->root_path = path;
+        this->base_offset = base_offset;
+        this->size = size;
+        this->offset = 0;
+
+        std::shared_ptr<FileHandle> parent_handle;
+        std::string parent_path;
+        size_t parent_offset;
+        size_t parent_size;
+        while(this->root_handle->GetSubrange(this->root_path, parent_handle, parent_path, parent_offset, parent_size)) {
+            this->root_handle = std::move(parent_handle);
+            this->root_path = std::move(parent_path);
+            this->base_offset += parent_offset;
+        }
+    }
+
+    bool SubrangeFileHandle::Exists(const std::string &path, size_t &out_size) {
+        out_size = this->size;
+        return this->root_handle != nullptr;
+    }
+
+    Result SubrangeFileHandle::Open(const std::string &path, const OpenMode mode) {
+        if(mode != OpenMode::Read) {
+            NTR_R_FAIL(ResultInvalidFileOpenMode);
+        }
+        if(this->root_handle == nullptr) {
+            NTR_R_FAIL(ResultInvalidFile);
+        }
+
+        NTR_R_TRY(this->root_handle->Open(this->root_path, OpenMode::Read));
+        this->offset = 0;
+        NTR_R_SUCCEED();
+    }
+
+    Result SubrangeFileHandle::GetSize(size_t &out_size) {
+        out_size = this->size;
+        NTR_R_SUCCEED();
+    }
+
+    Result SubrangeFileHandle::SetOffset(const size_t offset, const Position pos) {
+        size_t new_offset;
+        switch(pos) {
+            case Position::Begin: {
+                new_offset = offset;
+                break;
+            }
+            case Position::Current: {
+                new_offset = this->offset + offset;
+                break;
+            }
+            default: {
+                NTR_R_FAIL(ResultInvalidSeekPosition);
+            }
+        }
+
+        if(new_offset > this->size) {
+            NTR_R_FAIL(ResultEndOfData);
+        }
+
+        this->offset = new_offset;
+        NTR_R_SUCCEED();
+    }
+
+    Result SubrangeFileHandle::GetOffset(size_t &out_offset) {
+        out_offset = this->offset;
+        NTR_R_SUCCEED();
+    }
+
+    Result SubrangeFileHandle::Read(void *read_buf, const size_t read_size, size_t &out_read_size) {
+        if(this->offset >= this->size) {
+            NTR_R_FAIL(ResultEndOfData);
+        }
+
+        // Always seek first, since the root handle might be shared with other handles
+        const auto actual_read_size = std::min(read_size, this->size - this->offset);
+        NTR_R_TRY(this->root_handle->SetOffset(this->base_offset + this->offset, Position::Begin));
+        NTR_R_TRY(this->root_handle->Read(read_buf, actual_read_size, out_read_size));
+        this->offset += out_read_size;
+        NTR_R_SUCCEED();
+    }
+
+    Result SubrangeFileHandle::Write(const void *write_buf, const size_t write_size) {
+        NTR_R_FAIL(ResultWriteNotSupported);
+    }
+
+    Result SubrangeFileHandle::Close() {
+        return this->root_handle->Close();
+    }
+
+    bool SubrangeFileHandle::GetSubrange(const std::string &path, std::shared_ptr<FileHandle> &out_parent_handle, std::string &out_parent_path, size_t &out_offset, size_t &out_size) {
+        if(this->root_handle == nullptr) {
+            return false;
+        }
+
+        out_parent_handle = this->root_handle;
+        out_parent_path = this->root_path;
+        out_offset = this->base_offset;
+        out_size = this->size;
+        return true;
+    }
+
+    Result SubrangeFileHandle::GetView(const size_t offset, const size_t size, std::shared_ptr<u8> &out_view) {
+        if((offset > this->size) || (size > (this->size - offset))) {
+            NTR_R_FAIL(ResultEndOfData);
+        }
+
+        return this->root_handle->GetView(this->base_offset + offset, size, out_view);
+    }
+
+}
@@ -1,94 +1,520 @@
 #include <ntr/util/util_Compression.hpp>
 #include <ntr/util/util_Memory.hpp>
 
+#ifdef NTR_HOST_BUILD
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#endif
+
 namespace ntr::util {
 
     namespace {
 
-        inline constexpr void GenerateNeedleTable(const u8 *needle, const size_t needle_size, u8 (&out_table)[0x100]) {
-            std::memset(out_table, static_cast<u8>(needle_size & 0xff), sizeof(out_table));
-            for(size_t i = 0; i < needle_size; i++) {
-                out_table[needle[i]] = needle_size - i;
-            }
-        }
+        constexpr size_t LzWindowSize = 0x1000;
+        constexpr size_t LzMinimumMatchSize = 3;
+        constexpr size_t LzHashBits = 12;
+        constexpr u32 LzNoPosition = UINT32_MAX;
+
+        struct LzLevelParameters {
+            size_t max_chain_depth;
+            // Matches this long are taken right away instead of looking for better ones
+            size_t nice_match_size;
+        };
+
+        // A chain can't hold more positions than the window, so the window size as depth always finds the longest match
+        constexpr LzLevelParameters FastLevelParameters = { 16, 32 };
+        constexpr LzLevelParameters LazyLevelParameters = { LzWindowSize, 0x111 };
+        constexpr LzLevelParameters OptimalLevelParameters = { LzWindowSize, 0x200 };
+
+        // What the parsers read from: either all the data in memory, or (when streaming) a buffer sliding over it, refilled from a read function
+        // Refilling keeps history_size bytes before the required offset, which must cover the window plus any positions not yet inserted into the hash chains
+
+        class LzInput {
+            private:
+                const u8 *data;
+                // Offset of data[0] in the whole data, and the end of what's available from there
+                size_t data_offset;
+                size_t data_end_offset;
+                size_t data_size;
+                u8 *buf;
+                size_t buf_size;
+                size_t history_size;
+                const LzReadFunction *read_fn;
+                Result rc;
+
+                void Refill(const size_t offset) {
+                    const auto keep_offset = std::max(offset - std::min(offset, this->history_size), this->data_offset);
+                    const auto keep_size = this->data_end_offset - keep_offset;
+                    std::memmove(this->buf, this->buf + (keep_offset - this->data_offset), keep_size);
+                    this->data_offset = keep_offset;
+
+                    auto buf_offset = keep_size;
+                    while((buf_offset < this->buf_size) && (this->data_end_offset < this->data_size)) {
+                        const auto read_size = std::min(this->buf_size - buf_offset, this->data_size - this->data_end_offset);
+                        size_t actual_read_size = 0;
+                        if(this->rc.IsSuccess()) {
+                            this->rc = (*this->read_fn)(this->buf + buf_offset, read_size, actual_read_size);
+                            if(this->rc.IsSuccess() && (actual_read_size == 0)) {
+                                this->rc = ResultCompressionUnexpectedEndOfData;
+                            }
+                        }
+
+                        // After a failure just keep the parsers going over zeros (the whole compression fails anyway)
+                        if(this->rc.IsFailure()) {
+                            std::memset(this->buf + buf_offset, 0, read_size);
+                            actual_read_size = read_size;
+                        }
+
+                        buf_offset += actual_read_size;
+                        this->data_end_offset += actual_read_size;
+                    }
+                }
+
+            public:
+                LzInput(const u8 *data, const size_t data_size) : data(data), data_offset(0), data_end_offset(data_size), data_size(data_size), buf(nullptr), buf_size(0), history_size(0), read_fn(nullptr), rc(ResultSuccess) {}
+
+                LzInput(const size_t data_size, const size_t history_size, const size_t buf_size, const LzReadFunction &read_fn) : data(nullptr), data_offset(0), data_end_offset(0), data_size(data_size), buf(util::NewArray<u8>(buf_size)), buf_size(buf_size), history_size(history_size), read_fn(std::addressof(read_fn)), rc(ResultSuccess) {
+                    this->data = this->buf;
+                }
+
+                LzInput(const LzInput&) = delete;
+
+                ~LzInput() {
+                    delete[] this->buf;
+                }
+
+                // Makes (up to the end of the data) size bytes from offset available
+                inline void Require(const size_t offset, const size_t size) {
+                    if((this->data_end_offset < this->data_size) && ((offset + size) > this->data_end_offset)) {
+                        this->Refill(offset);
+                    }
+                }
+
+                inline const u8 *At(const size_t offset) const {
+                    return this->data + (offset - this->data_offset);
+                }
+
+                inline size_t GetEndOffset() const {
+                    return this->data_end_offset;
+                }
+
+                inline size_t GetSize() const {
+                    return this->data_size;
+                }
+
+                inline Result GetResult() const {
+                    return this->rc;
+                }
+        };
+
+        // Hash chains over 3-byte prefixes: head holds the latest position for each hash, prev links each position in the window to the previous one with the same hash
+
+        class LzMatchFinder {
+            private:
+                const LzInput &input;
+                u32 *head;
+                u32 *prev;
+                size_t next_insert_offset;
+
+                static inline size_t Hash(const u8 *ptr) {
+                    const u32 v = ptr[0] | (ptr[1] << 8) | (ptr[2] << 16);
+                    return (v * 2654435761u) >> (32 - LzHashBits);
+                }
+
+                inline void Insert(const size_t offset) {
+                    const auto h = Hash(this->input.At(offset));
+                    this->prev[offset & (LzWindowSize - 1)] = this->head[h];
+                    this->head[h] = static_cast<u32>(offset);
+                }
+
+            public:
+                LzMatchFinder(const LzInput &input) : input(input), head(util::NewArray<u32>(1 << LzHashBits)), prev(util::NewArray<u32>(LzWindowSize)), next_insert_offset(0) {
+                    std::fill_n(this->head, 1 << LzHashBits, LzNoPosition);
+                }
 
-        bool SearchOne(const u8 *haystack, const size_t haystack_size, const u8 *needle, const size_t needle_size, const u8 needle_table[0x100], size_t &out) {
-            size_t cur = 0;
-            while((haystack_size - cur) >= needle_size) {
-                for(size_t i = 0; i < needle_size; i++) {
-                    const auto j = needle_size - i - 1;
-                    if(haystack[cur + j] == needle[j]) {
-                        out = cur;
+                ~LzMatchFinder() {
+                    delete[] this->head;
+                    delete[] this->prev;
+                }
+
+                // Positions must be visited in increasing order: every skipped one (inside matches) is still inserted into the chains
+                // Matches only extend up to the end of the available input
+                bool FindLongestMatch(const size_t offset, const size_t max, const LzLevelParameters &params, size_t &out_offset, size_t &out_size) {
+                    const auto end_offset = this->input.GetEndOffset();
+                    const auto insert_end = std::min(offset, end_offset - std::min(end_offset, LzMinimumMatchSize - 1));
+                    while(this->next_insert_offset < insert_end) {
+                        this->Insert(this->next_insert_offset);
+                        this->next_insert_offset++;
+                    }
+
+                    if((offset < 4) || ((end_offset - offset) < 4)) {
+                        return false;
+                    }
+
+                    const auto cur_data = this->input.At(offset);
+                    const auto cur_max = std::min(max, end_offset - offset);
+                    size_t longest_offset = 0;
+                    size_t longest_size = 0;
+                    auto cand_offset = this->head[Hash(cur_data)];
+                    for(size_t i = 0; (i < params.max_chain_depth) && (cand_offset != LzNoPosition) && ((offset - cand_offset) <= LzWindowSize); i++) {
+                        const auto cand_data = this->input.At(cand_offset);
+                        // Quick rejection: a longer match must also match at the current longest size
+                        if((cand_data[longest_size] == cur_data[longest_size]) && (cand_data[0] == cur_data[0]) && (cand_data[1] == cur_data[1]) && (cand_data[2] == cur_data[2])) {
+                            size_t size = LzMinimumMatchSize;
+                            while((size < cur_max) && (cand_data[size] == cur_data[size])) {
+                                size++;
+                            }
+
+                            // Nearest matches win ties, since they are found first
+                            if(size > longest_size) {
+                                longest_offset = cand_offset;
+                                longest_size = size;
+                                if((size == cur_max) || (size >= params.nice_match_size)) {
+                                    break;
+                                }
+                            }
+                        }
+
+                        cand_offset = this->prev[cand_offset & (LzWindowSize - 1)];
+                    }
+
+                    if(longest_size < LzMinimumMatchSize) {
+                        return false;
+                    }
+                    else {
+                        out_offset = longest_offset;
+                        out_size = longest_size;
                         return true;
                     }
                 }
+        };
+
+
+        // Writes tokens grouped by 8 after their flag byte, exactly as the decompressor reads them
+        // With a write function, the output buffer is written out (and reused) whenever the next group might not fit in it
+
+        // Flag byte + 8 of the longest (LZ11) back-references
+        constexpr size_t LzMaximumTokenGroupSize = 1 + 8 * 4;
+
+        class LzTokenWriter {
+            private:
+                LzVersion ver;
+                u8 *out;
+                size_t out_size;
+                size_t out_offset;
+                size_t flags_offset;
+                ssize_t index;
+                const LzWriteFunction *write_fn;
+                size_t written_size;
+                Result rc;
+
+                void Flush() {
+                    if(this->rc.IsSuccess()) {
+                        this->rc = (*this->write_fn)(this->out, this->out_offset);
+                    }
+                    this->written_size += this->out_offset;
+                    this->out_offset = 0;
+                }
+
+                inline void BeginToken(const bool is_match) {
+                    if(this->index < 0) {
+                        if((this->write_fn != nullptr) && ((this->out_offset + LzMaximumTokenGroupSize) > this->out_size)) {
+                            this->Flush();
+                        }
+
+                        this->flags_offset = this->out_offset;
+                        this->out[this->flags_offset] = 0;
+                        this->out_offset++;
+                        this->index = 7;
+                    }
+
+                    if(is_match) {
+                        this->out[this->flags_offset] |= static_cast<u8>(1 << this->index);
+                    }
+                    this->index--;
+                }
+
+                inline void Put(const u8 byte) {
+                    this->out[this->out_offset] = byte;
+                    this->out_offset++;
+                }
+
+            public:
+                LzTokenWriter(const LzVersion ver, u8 *out) : ver(ver), out(out), out_size(0), out_offset(0), flags_offset(0), index(-1), write_fn(nullptr), written_size(0), rc(ResultSuccess) {}
+                LzTokenWriter(const LzVersion ver, u8 *out, const size_t out_size, const LzWriteFunction &write_fn) : ver(ver), out(out), out_size(out_size), out_offset(0), flags_offset(0), index(-1), write_fn(std::addressof(write_fn)), written_size(0), rc(ResultSuccess) {}
+
+                inline void WriteLiteral(const u8 byte) {
+                    this->BeginToken(false);
+                    this->Put(byte);
+                }
+
+                void WriteMatch(const size_t distance, const size_t size) {
+                    this->BeginToken(true);
+
+                    const auto lz_offset = distance - 1;
+                    if(this->ver == LzVersion::LZ10) {
+                        const auto l = size - 0x3;
+                        this->Put(static_cast<u8>((lz_offset >> 8) & 0xff) + static_cast<u8>((l << 4) & 0xff));
+                        this->Put(static_cast<u8>(lz_offset & 0xff));
+                    }
+                    else if(this->ver == LzVersion::LZ11) {
+                        if(size < 0x11) {
+                            const auto l = size - 0x1;
+                            this->Put(static_cast<u8>((lz_offset >> 8) & 0xff) + static_cast<u8>((l << 4) & 0xff));
+                            this->Put(static_cast<u8>(lz_offset & 0xff));
+                        }
+                        else if(size < 0x111) {
+                            const auto l = size - 0x11;
+                            this->Put(static_cast<u8>((l >> 4) & 0xff));
+                            this->Put(static_cast<u8>((lz_offset >> 8) & 0xff) + static_cast<u8>((l << 4) & 0xff));
+                            this->Put(static_cast<u8>(lz_offset & 0xff));
+                        }
+                        else {
+                            const auto l = size - 0x111;
+                            this->Put(static_cast<u8>((l >> 12) & 0xff) + 0x10);
+                            this->Put(static_cast<u8>((l >> 4) & 0xff));
+                            this->Put(static_cast<u8>((lz_offset >> 8) & 0xff) + static_cast<u8>((l << 4) & 0xff));
+                            this->Put(static_cast<u8>(lz_offset & 0xff));
+                        }
+                    }
+                }
+
+                // Appends the trailing byte (writing out everything left), returns the total written size
+                inline size_t Finish() {
+                    if((this->write_fn != nullptr) && ((this->out_offset + 1) > this->out_size)) {
+                        this->Flush();
+                    }
+                    this->Put(0xff);
+
+                    if(this->write_fn != nullptr) {
+                        this->Flush();
+                    }
+                    return this->written_size + this->out_offset;
+                }
+
+                inline Result GetResult() const {
+                    return this->rc;
+                }
+        };
 
-                cur += needle_table[haystack[cur + needle_size - 1]];
+        void ParseGreedy(LzInput &input, const size_t repeat_size, LzMatchFinder &match_finder, LzTokenWriter &writer) {
+            const auto data_size = input.GetSize();
+            size_t offset = 0;
+            while(offset < data_size) {
+                input.Require(offset, repeat_size);
+
+                size_t find_offset;
+                size_t find_size;
+                if(match_finder.FindLongestMatch(offset, repeat_size, FastLevelParameters, find_offset, find_size)) {
+                    writer.WriteMatch(offset - find_offset, find_size);
+                    offset += find_size;
+                }
+                else {
+                    writer.WriteLiteral(*input.At(offset));
+                    offset++;
+                }
             }
-            
-            return false;
         }
 
-        std::vector<size_t> Search(const u8 *haystack, const size_t haystack_size, const u8 *needle, const size_t needle_size) {
-            u8 needle_table[0x100] = {};
-            GenerateNeedleTable(needle, needle_size, needle_table);
+        // Before taking a match, checks whether the next position has a longer one (then the current byte goes as a literal instead)
+        void ParseLazy(LzInput &input, const size_t repeat_size, LzMatchFinder &match_finder, LzTokenWriter &writer) {
+            const auto &params = LazyLevelParameters;
+            const auto data_size = input.GetSize();
 
-            size_t cur = 0;
-            std::vector<size_t> offsets;
-            while((cur + needle_size) < haystack_size) {
-                size_t found_offset;
-                if(SearchOne(haystack + cur, haystack_size - cur, needle, needle_size, needle_table, found_offset)) {
-                    offsets.push_back(found_offset);
-                    cur += found_offset + needle_size + 1;
+            size_t offset = 0;
+            bool has_match = false;
+            size_t find_offset = 0;
+            size_t find_size = 0;
+            while(offset < data_size) {
+                // The next position is also searched
+                input.Require(offset, repeat_size + 1);
+
+                if(!has_match) {
+                    has_match = match_finder.FindLongestMatch(offset, repeat_size, params, find_offset, find_size);
+                }
+
+                if(has_match) {
+                    size_t next_find_offset;
+                    size_t next_find_size;
+                    if((find_size < params.nice_match_size) && match_finder.FindLongestMatch(offset + 1, repeat_size, params, next_find_offset, next_find_size) && (next_find_size > find_size)) {
+                        writer.WriteLiteral(*input.At(offset));
+                        offset++;
+                        find_offset = next_find_offset;
+                        find_size = next_find_size;
+                        continue;
+                    }
+
+                    writer.WriteMatch(offset - find_offset, find_size);
+                    offset += find_size;
+                    has_match = false;
                 }
                 else {
-                    break;
+                    writer.WriteLiteral(*input.At(offset));
+                    offset++;
                 }
             }
+        }
 
-            return offsets;
+        #ifdef NTR_HOST_BUILD
+        constexpr size_t LzOptimalBlockSize = 0x8000;
+        #else
+        constexpr size_t LzOptimalBlockSize = 0x1000;
+        #endif
+
+        // Token costs in bits, the flag bit included
+        inline u32 GetLiteralCost() {
+            return 1 + 8;
         }
 
-        bool FindLongestMatch(const u8 *data, const size_t data_size, const size_t offset, const size_t max, size_t &out_offset, size_t &out_size) {
-            if((offset < 4) || ((data_size - offset) < 4)) {
-                return false;
+        inline u32 GetMatchCost(const LzVersion ver, const size_t size) {
+            if((ver == LzVersion::LZ10) || (size < 0x11)) {
+                return 1 + 16;
             }
-
-            size_t longest_offset = 0;
-            size_t longest_size = 0;
-            size_t start = 0;
-            if(offset > 0x1000) {
-                start = offset - 0x1000;
+            else if(size < 0x111) {
+                return 1 + 24;
             }
+            else {
+                return 1 + 32;
+            }
+        }
 
-            const auto offsets = Search(data + start, offset + 2 - start, data + offset, 3);
-            for(const auto &found_offset: offsets) {
-                size_t size = 0;
-                for(size_t i = 0; i < (data_size - offset); i++) {
-                    const auto p = i + offset;
-                    if(size == max) {
-                        out_offset = start + found_offset;
-                        out_size = size;
-                        return true;
+        // Shortest path over the token costs, in blocks to keep its memory bounded
+        // Each block is parsed a bit past its end so that the path isn't cut short there: tokens are only taken up to the block end, and parsing resumes where the last one ends
+        void ParseOptimal(LzInput &input, const LzVersion ver, const size_t repeat_size, LzMatchFinder &match_finder, LzTokenWriter &writer) {
+            const auto &params = OptimalLevelParameters;
+            const auto data_size = input.GetSize();
+            // Matches at least this long are always taken, so none reaching past this is considered
+            const auto parse_size = LzOptimalBlockSize + params.nice_match_size;
+
+            // For each position: the cheapest cost to reach it, the token (size, and distance if it's a match) reaching it that way, and the longest match starting there
+            auto costs = util::NewArray<u32>(parse_size + 1);
+            auto token_sizes = util::NewArray<u32>(parse_size + 1);
+            auto token_distances = util::NewArray<u16>(parse_size + 1);
+            auto match_sizes = util::NewArray<u32>(parse_size);
+            auto match_distances = util::NewArray<u16>(parse_size);
+            ScopeGuard on_exit_cleanup([&]() {
+                delete[] costs;
+                delete[] token_sizes;
+                delete[] token_distances;
+                delete[] match_sizes;
+                delete[] match_distances;
+            });
+
+            size_t block_offset = 0;
+            // Matches at the start of the block already found while parsing the previous one (the finder can't go back)
+            size_t found_match_count = 0;
+            while(block_offset < data_size) {
+                input.Require(block_offset, parse_size + repeat_size);
+
+                auto cur_parse_size = std::min(parse_size, data_size - block_offset);
+                const auto is_last_block = (block_offset + cur_parse_size) == data_size;
+                std::fill_n(costs, cur_parse_size + 1, UINT32_MAX);
+                costs[0] = 0;
+
+                size_t nice_match_size = 0;
+                for(size_t i = 0; i < cur_parse_size; i++) {
+                    const auto offset = block_offset + i;
+                    if((costs[i] + GetLiteralCost()) < costs[i + 1]) {
+                        costs[i + 1] = costs[i] + GetLiteralCost();
+                        token_sizes[i + 1] = 1;
                     }
-                    if(data[p] != data[start + found_offset + i]) {
+
+                    if(i >= found_match_count) {
+                        size_t find_offset;
+                        size_t find_size;
+                        if(match_finder.FindLongestMatch(offset, repeat_size, params, find_offset, find_size)) {
+                            match_sizes[i] = find_size;
+                            match_distances[i] = static_cast<u16>(offset - find_offset);
+                        }
+                        else {
+                            match_sizes[i] = 0;
+                        }
+                    }
+
+                    if(match_sizes[i] >= params.nice_match_size) {
+                        // Stop here: the path up to this position is final, and the long match follows it
+                        cur_parse_size = i;
+                        nice_match_size = match_sizes[i];
                         break;
                     }
-                    size++;
+
+                    // Any shorter size is also a match at the same distance (but among the longest LZ11 ones, which all cost the same, just try the longest)
+                    const auto max_size = std::min<size_t>(match_sizes[i], cur_parse_size - i);
+                    for(size_t size = LzMinimumMatchSize; size <= max_size; size++) {
+                        if((size >= 0x111) && (size < max_size)) {
+                            size = max_size;
+                        }
+
+                        const auto cost = costs[i] + GetMatchCost(ver, size);
+                        if(cost < costs[i + size]) {
+                            costs[i + size] = cost;
+                            token_sizes[i + size] = size;
+                            token_distances[i + size] = match_distances[i];
+                        }
+                    }
                 }
-                if(size > longest_size) {
-                    longest_offset = found_offset;
-                    longest_size = size;
+
+                // Walk the path back, leaving in each position's cost the size of the token starting there
+                auto path_offset = cur_parse_size;
+                while(path_offset > 0) {
+                    const auto size = token_sizes[path_offset];
+                    costs[path_offset - size] = size;
+                    path_offset -= size;
+                }
+
+                const auto take_size = ((nice_match_size > 0) || is_last_block) ? cur_parse_size : std::min(LzOptimalBlockSize, cur_parse_size);
+                path_offset = 0;
+                while(path_offset < take_size) {
+                    const auto size = costs[path_offset];
+                    if(size == 1) {
+                        writer.WriteLiteral(*input.At(block_offset + path_offset));
+                    }
+                    else {
+                        writer.WriteMatch(token_distances[path_offset + size], size);
+                    }
+                    path_offset += size;
+                }
+
+                if(nice_match_size > 0) {
+                    writer.WriteMatch(match_distances[path_offset], nice_match_size);
+                    block_offset += path_offset + nice_match_size;
+                    found_match_count = 0;
+                }
+                else {
+                    found_match_count = cur_parse_size - path_offset;
+                    std::copy_n(match_sizes + path_offset, found_match_count, match_sizes);
+                    std::copy_n(match_distances + path_offset, found_match_count, match_distances);
+                    block_offset += path_offset;
                 }
             }
+        }
 
-            if(longest_size < 3) {
-                return false;
+        constexpr size_t WideMatchCopySize = 16;
+
+        // Back-references may overlap what they produce (a distance smaller than the size repeats the last distance bytes), so they are copied in non-overlapping pieces
+        inline void CopyMatch(u8 *dst, const size_t distance, const size_t size, const size_t dst_left_size) {
+            const auto src = dst - distance;
+            // Fixed-size pieces are much faster to copy, and writing a bit past the end is fine with enough room left (it's overwritten later)
+            if((distance >= WideMatchCopySize) && (util::AlignUp(size, WideMatchCopySize) <= dst_left_size)) {
+                for(size_t i = 0; i < size; i += WideMatchCopySize) {
+                    std::memcpy(dst + i, src + i, WideMatchCopySize);
+                }
+                return;
             }
-            else {
-                out_offset = start + longest_offset;
-                out_size = longest_size;
-                return true;
+
+            if(distance == 1) {
+                std::memset(dst, src[0], size);
+                return;
+            }
+
+            // The first distance bytes, then doubling what was already produced (which always spans whole repetitions)
+            auto copied_size = std::min(distance, size);
+            std::memcpy(dst, src, copied_size);
+            while(copied_size < size) {
+                const auto copy_size = std::min(copied_size, size - copied_size);
+                std::memcpy(dst + copied_size, dst, copy_size);
+                copied_size += copy_size;
             }
         }
 
@@ -103,131 +529,226 @@ namespace ntr::util {
         NTR_R_SUCCEED();
     }
 
-    // TODO: proper buffer readers?
+    namespace {
 
-    Result LzCompress(const u8 *data, const size_t data_size, const LzVersion ver, const u32 repeat_size, u8 *&out_data, size_t &out_size) {
-        const auto tmp_out_size_estimate = data_size + data_size / 8 + 4;
-        auto tmp_out_data = util::NewArray<u8>(tmp_out_size_estimate);
-        ScopeGuard on_exit_cleanup_1([&]() {
-            delete[] tmp_out_data;
-        });
+        // LZ11 header (the LZ10 one is just the first word)
+        constexpr size_t LzMaximumHeaderSize = 2 * sizeof(u32);
 
-        size_t out_offset = 0;
-        if(ver == LzVersion::LZ10) {
-            if(data_size > MaximumLZ10CompressSize) {
-                NTR_R_FAIL(ResultCompressionTooBigCompressSize);
-            }
-            if(repeat_size != LZ10RepeatSize) {
-                NTR_R_FAIL(ResultCompressionInvalidRepeatSize);
+        Result WriteLzHeader(const size_t data_size, const LzVersion ver, const u32 repeat_size, u8 *out_data, size_t &out_header_size) {
+            if(ver == LzVersion::LZ10) {
+                if(data_size > MaximumLZ10CompressSize) {
+                    NTR_R_FAIL(ResultCompressionTooBigCompressSize);
+                }
+                if(repeat_size != LZ10RepeatSize) {
+                    NTR_R_FAIL(ResultCompressionInvalidRepeatSize);
+                }
+
+                const auto header_32 = static_cast<u32>(ver) + static_cast<u32>(data_size << 8);
+                *reinterpret_cast<u32*>(out_data) = header_32;
+                out_header_size = sizeof(u32);
             }
+            else if(ver == LzVersion::LZ11) {
+                if(data_size > MaximumLZ11CompressSize) {
+                    NTR_R_FAIL(ResultCompressionTooBigCompressSize);
+                }
+                if(repeat_size > MaximumLZ11RepeatSize) {
+                    NTR_R_FAIL(ResultCompressionInvalidRepeatSize);
+                }
 
-            const auto header_32 = static_cast<u32>(ver) + static_cast<u32>(data_size << 8);
-            *reinterpret_cast<u32*>(tmp_out_data + out_offset) = header_32;
-            out_offset += sizeof(u32);
-        }
-        else if(ver == LzVersion::LZ11) {
-            if(data_size > MaximumLZ11CompressSize) {
-                NTR_R_FAIL(ResultCompressionTooBigCompressSize);
+                *reinterpret_cast<u32*>(out_data) = static_cast<u32>(ver);
+                *reinterpret_cast<u32*>(out_data + sizeof(u32)) = static_cast<u32>(data_size);
+                out_header_size = 2 * sizeof(u32);
             }
-            if(repeat_size > MaximumLZ11RepeatSize) {
-                NTR_R_FAIL(ResultCompressionInvalidRepeatSize);
+            else {
+                NTR_R_FAIL(ResultCompressionInvalidLzFormat);
             }
 
-            *reinterpret_cast<u32*>(tmp_out_data + out_offset) = static_cast<u32>(ver);
-            out_offset += sizeof(u32);
-            *reinterpret_cast<u32*>(tmp_out_data + out_offset) = static_cast<u32>(data_size);
-            out_offset += sizeof(u32);
+            NTR_R_SUCCEED();
         }
-        else {
-            NTR_R_FAIL(ResultCompressionInvalidLzFormat);
+
+        Result ParseLz(LzInput &input, const LzVersion ver, const size_t repeat_size, const LzCompressionLevel level, LzTokenWriter &writer) {
+            LzMatchFinder match_finder(input);
+            switch(level) {
+                case LzCompressionLevel::Fast: {
+                    ParseGreedy(input, repeat_size, match_finder, writer);
+                    break;
+                }
+                case LzCompressionLevel::Lazy: {
+                    ParseLazy(input, repeat_size, match_finder, writer);
+                    break;
+                }
+                case LzCompressionLevel::Optimal: {
+                    ParseOptimal(input, ver, repeat_size, match_finder, writer);
+                    break;
+                }
+                default: {
+                    NTR_R_FAIL(ResultCompressionInvalidLevel);
+                }
+            }
+
+            NTR_R_SUCCEED();
         }
 
-        size_t offset = 0;
-        u8 byte = 0;
-        ssize_t index = 7;
-        auto cmp_buf = util::NewArray<u8>(tmp_out_size_estimate);
-        size_t cmp_buf_offset = 0;
-        ScopeGuard on_exit_cleanup_2([&]() {
-            delete[] cmp_buf;
-        });
-        while(offset < data_size) {
-            size_t find_offset;
-            size_t find_size;
-            if(FindLongestMatch(data, data_size, offset, repeat_size, find_offset, find_size)) {
-                const auto lz_offset = offset - find_offset - 1;
-                byte |= static_cast<u8>(1 << index);
-                index--;
-
-                if(ver == LzVersion::LZ10) {
-                    const auto l = find_size - 0x3;
-                    cmp_buf[cmp_buf_offset] = static_cast<u8>((lz_offset >> 8) & 0xff) + static_cast<u8>((l << 4) & 0xff);
-                    cmp_buf_offset++;
-                    cmp_buf[cmp_buf_offset] = static_cast<u8>(lz_offset & 0xff);
-                    cmp_buf_offset++;
-                }
-                else if(ver == LzVersion::LZ11) {
-                    if(find_size < 0x11) {
-                        const auto l = find_size - 0x1;
-                        cmp_buf[cmp_buf_offset] = static_cast<u8>((lz_offset >> 8) & 0xff) + static_cast<u8>((l << 4) & 0xff);
-                        cmp_buf_offset++;
-                        cmp_buf[cmp_buf_offset] = static_cast<u8>(lz_offset & 0xff);
-                        cmp_buf_offset++;
-                    }
-                    else if(find_size < 0x111) {
-                        const auto l = find_size - 0x11;
-                        cmp_buf[cmp_buf_offset] = static_cast<u8>((l >> 4) & 0xff);
-                        cmp_buf_offset++;
-                        cmp_buf[cmp_buf_offset] = static_cast<u8>((lz_offset >> 8) & 0xff) + static_cast<u8>((l << 4) & 0xff);
-                        cmp_buf_offset++;
-                        cmp_buf[cmp_buf_offset] = static_cast<u8>(lz_offset & 0xff);
-                        cmp_buf_offset++;
-                    }
-                    else {
-                        const auto l = find_size - 0x111;
-                        cmp_buf[cmp_buf_offset] = static_cast<u8>((l >> 12) & 0xff) + 0x10;
-                        cmp_buf_offset++;
-                        cmp_buf[cmp_buf_offset] = static_cast<u8>((l >> 4) & 0xff);
-                        cmp_buf_offset++;
-                        cmp_buf[cmp_buf_offset] = static_cast<u8>((lz_offset >> 8) & 0xff) + static_cast<u8>((l << 4) & 0xff);
-                        cmp_buf_offset++;
-                        cmp_buf[cmp_buf_offset] = static_cast<u8>(lz_offset & 0xff);
-                        cmp_buf_offset++;
-                    }
-                }
-                offset += find_size;
+        // Streaming input buffers hold the history (the window plus up to a match's worth of positions not yet in the hash chains), what the parser requires ahead and some room so reads aren't too small
+        constexpr size_t LzStreamRefillSize = 0x4000;
+        constexpr size_t LzStreamOutputBufferSize = 0x1000;
+
+        inline size_t GetLzStreamRequiredSize(const LzCompressionLevel level, const size_t repeat_size) {
+            if(level == LzCompressionLevel::Optimal) {
+                return LzOptimalBlockSize + OptimalLevelParameters.nice_match_size + repeat_size;
             }
             else {
-                index--;
-                cmp_buf[cmp_buf_offset] = data[offset];
-                offset++;
-                cmp_buf_offset++;
+                return repeat_size + 1;
             }
+        }
 
-            if(index < 0) {
-                tmp_out_data[out_offset] = byte;
-                out_offset++;
-                if(cmp_buf_offset > 0) {
-                    std::memcpy(tmp_out_data + out_offset, cmp_buf, cmp_buf_offset);
-                    out_offset += cmp_buf_offset;
+    }
+
+    // TODO: proper buffer readers?
+
+    Result LzCompress(const u8 *data, const size_t data_size, const LzVersion ver, const u32 repeat_size, const LzCompressionLevel level, u8 *&out_data, size_t &out_size) {
+        // Worst case: every byte is a literal (plus a flag byte every 8 tokens), the biggest header and the trailing byte
+        const auto tmp_out_size_estimate = LzMaximumHeaderSize + data_size + (data_size + 7) / 8 + 1;
+        auto tmp_out_data = util::NewArray<u8>(tmp_out_size_estimate);
+        ScopeGuard on_exit_cleanup([&]() {
+            delete[] tmp_out_data;
+        });
+
+        size_t out_offset;
+        NTR_R_TRY(WriteLzHeader(data_size, ver, repeat_size, tmp_out_data, out_offset));
+
+        LzInput input(data, data_size);
+        LzTokenWriter writer(ver, tmp_out_data + out_offset);
+        NTR_R_TRY(ParseLz(input, ver, repeat_size, level, writer));
+        out_offset += writer.Finish();
+
+        out_data = util::NewArray<u8>(out_offset);
+        out_size = out_offset;
+        std::memcpy(out_data, tmp_out_data, out_offset);
+        NTR_R_SUCCEED();
+    }
+
+    Result LzCompressStream(const size_t data_size, const LzVersion ver, const u32 repeat_size, const LzCompressionLevel level, const LzReadFunction &read_fn, const LzWriteFunction &write_fn, size_t &out_size) {
+        u8 header[LzMaximumHeaderSize];
+        size_t header_size;
+        NTR_R_TRY(WriteLzHeader(data_size, ver, repeat_size, header, header_size));
+        NTR_R_TRY(write_fn(header, header_size));
+
+        const auto stream_repeat_size = std::min<size_t>(repeat_size, LzStreamMaximumMatchSize);
+        const auto history_size = LzWindowSize + stream_repeat_size;
+        LzInput input(data_size, history_size, history_size + GetLzStreamRequiredSize(level, stream_repeat_size) + LzStreamRefillSize, read_fn);
+
+        auto out_buf = util::NewArray<u8>(LzStreamOutputBufferSize);
+        ScopeGuard on_exit_cleanup([&]() {
+            delete[] out_buf;
+        });
+        LzTokenWriter writer(ver, out_buf, LzStreamOutputBufferSize, write_fn);
+        NTR_R_TRY(ParseLz(input, ver, stream_repeat_size, level, writer));
+        const auto tokens_size = writer.Finish();
+
+        NTR_R_TRY(input.GetResult());
+        NTR_R_TRY(writer.GetResult());
+        out_size = header_size + tokens_size;
+        NTR_R_SUCCEED();
+    }
+
+    namespace {
+
+        inline void RunLzCompressJob(LzCompressJob &job) {
+            job.out_data = nullptr;
+            job.out_size = 0;
+            job.rc = LzCompress(job.data, job.data_size, job.ver, job.repeat_size, job.level, job.out_data, job.out_size);
+        }
+
+        void RunLzCompressJobs(LzCompressJob *jobs, const size_t job_count) {
+            for(size_t i = 0; i < job_count; i++) {
+                RunLzCompressJob(jobs[i]);
+            }
+        }
+
+        #ifdef NTR_HOST_BUILD
+
+        // Note: jobs are started in order, so a big one waiting for memory also holds back the ones after it (which keeps the wait bounded)
+
+        void RunLzCompressJobsConcurrently(LzCompressJob *jobs, const size_t job_count, const size_t thread_count, const size_t mem_budget) {
+            std::mutex lock;
+            std::condition_variable cond;
+            size_t next_job_idx = 0;
+            size_t running_count = 0;
+            size_t used_mem_size = 0;
+
+            auto worker = [&]() {
+                while(true) {
+                    LzCompressJob *job;
+                    size_t job_mem_size = 0;
+                    {
+                        std::unique_lock<std::mutex> guard(lock);
+                        cond.wait(guard, [&]() {
+                            if(next_job_idx == job_count) {
+                                return true;
+                            }
+
+                            job_mem_size = GetLzCompressMemorySize(jobs[next_job_idx].data_size);
+                            return (running_count == 0) || ((used_mem_size + job_mem_size) <= mem_budget);
+                        });
+                        if(next_job_idx == job_count) {
+                            break;
+                        }
+
+                        job = jobs + next_job_idx;
+                        next_job_idx++;
+                        running_count++;
+                        used_mem_size += job_mem_size;
+                    }
+
+                    RunLzCompressJob(*job);
+
+                    {
+                        std::lock_guard<std::mutex> guard(lock);
+                        running_count--;
+                        used_mem_size -= job_mem_size;
+                    }
+                    cond.notify_all();
                 }
-                cmp_buf_offset = 0;
-                byte = 0;
-                index = 7;
+            };
+
+            std::vector<std::thread> workers;
+            workers.reserve(thread_count - 1);
+            for(size_t i = 0; i < (thread_count - 1); i++) {
+                workers.emplace_back(worker);
+            }
+            worker();
+
+            for(auto &worker_thread : workers) {
+                worker_thread.join();
             }
         }
 
-        if(cmp_buf_offset > 0) {
-            tmp_out_data[out_offset] = byte;
-            out_offset++;
-            std::memcpy(tmp_out_data + out_offset, cmp_buf, cmp_buf_offset);
-            out_offset += cmp_buf_offset;
+        #endif
+
+    }
+
+    Result LzCompressBatch(LzCompressJob *jobs, const size_t job_count, const size_t thread_count, const size_t mem_budget) {
+        #ifdef NTR_HOST_BUILD
+        auto actual_thread_count = thread_count;
+        if(actual_thread_count == 0) {
+            actual_thread_count = std::max<size_t>(std::thread::hardware_concurrency(), 1);
         }
-        tmp_out_data[out_offset] = 0xff;
-        out_offset++;
+        actual_thread_count = std::min(actual_thread_count, job_count);
 
-        out_data = util::NewArray<u8>(out_offset);
-        out_size = out_offset;
-        std::memcpy(out_data, tmp_out_data, out_offset);
+        if(actual_thread_count > 1) {
+            RunLzCompressJobsConcurrently(jobs, job_count, actual_thread_count, mem_budget);
+        }
+        else {
+            RunLzCompressJobs(jobs, job_count);
+        }
+        #else
+        RunLzCompressJobs(jobs, job_count);
+        #endif
+
+        for(size_t i = 0; i < job_count; i++) {
+            NTR_R_TRY(jobs[i].rc);
+        }
         NTR_R_SUCCEED();
     }
 
@@ -249,41 +770,84 @@ namespace ntr::util {
     
     */
 
-    Result LzDecompress(const u8 *data, u8 *&out_data, size_t &out_size, LzVersion &out_ver, size_t &out_used_data_size) {
+    Result LzReadHeader(const u8 *data, const size_t data_size, LzVersion &out_ver, size_t &out_dec_size, size_t &out_header_size) {
+        if(data_size < sizeof(u32)) {
+            NTR_R_FAIL(ResultCompressionInvalidLzFormat);
+        }
+
         size_t offset = 0;
         const auto lz_header = *reinterpret_cast<const u32*>(data);
         offset += sizeof(u32);
+        NTR_R_TRY(LzValidateCompressed(lz_header, out_ver));
 
-        LzVersion ver;
-        NTR_R_TRY(LzValidateCompressed(lz_header, ver));
+        out_dec_size = lz_header >> 8;
+        if((out_dec_size == 0) && (out_ver == LzVersion::LZ11)) {
+            if(data_size < (offset + sizeof(u32))) {
+                NTR_R_FAIL(ResultCompressionInvalidLzFormat);
+            }
 
-        out_size = lz_header >> 8;
-        out_ver = ver;
-        if((out_size == 0) && (ver == LzVersion::LZ11)) {
-            out_size = *reinterpret_cast<const u32*>(data + offset);
+            out_dec_size = *reinterpret_cast<const u32*>(data + offset);
             offset += sizeof(u32);
         }
-        out_data = util::NewArray<u8>(out_size);
+
+        out_header_size = offset;
+        NTR_R_SUCCEED();
+    }
+
+    Result LzDecompress(const u8 *data, u8 *&out_data, size_t &out_size, LzVersion &out_ver, size_t &out_used_data_size) {
+        // Note: the compressed size is unknown here, so the data is trusted not to end early
+        size_t dec_size;
+        size_t header_size;
+        NTR_R_TRY(LzReadHeader(data, SIZE_MAX, out_ver, dec_size, header_size));
+
+        out_data = util::NewArray<u8>(dec_size);
+        const auto rc = LzDecompress(data, SIZE_MAX, out_data, dec_size, out_ver, out_size, out_used_data_size);
+        if(rc.IsFailure()) {
+            delete[] out_data;
+            out_data = nullptr;
+        }
+        return rc;
+    }
+
+    Result LzDecompress(const u8 *data, const size_t data_size, u8 *out_data, const size_t out_data_size, LzVersion &out_ver, size_t &out_dec_size, size_t &out_used_data_size) {
+        size_t dec_size;
+        size_t offset;
+        NTR_R_TRY(LzReadHeader(data, data_size, out_ver, dec_size, offset));
+        if(out_data_size < dec_size) {
+            NTR_R_FAIL(ResultCompressionOutputBufferTooSmall);
+        }
+        if((out_data == nullptr) && (dec_size > 0)) {
+            NTR_R_FAIL(ResultCompressionInvalidOutputBuffer);
+        }
+        const auto ver = out_ver;
 
         size_t out_offset = 0;
-        while(out_offset < out_size) {
-            const auto cur_byte = data[offset];
+        while(out_offset < dec_size) {
+            if(offset >= data_size) {
+                NTR_R_FAIL(ResultCompressionUnexpectedEndOfData);
+            }
+            const auto flags = data[offset];
             offset++;
 
-            for(u8 i = 0; i < 8; i++) {
-                if(out_offset >= out_size) {
-                    break;
-                }
+            // A whole group of literals
+            if((flags == 0) && ((data_size - offset) >= 8) && ((dec_size - out_offset) >= 8)) {
+                std::memcpy(out_data + out_offset, data + offset, 8);
+                offset += 8;
+                out_offset += 8;
+                continue;
+            }
 
-                const auto bit = 8 - (i + 1);
-                if((cur_byte >> bit) & 1) {
-                    const size_t msb_len = data[offset];
-                    offset++;
-                    const size_t lsb = data[offset]; // 4 bits (length) + 12 bits (disp)
-                    offset++;
+            for(u32 i = 0; (i < 8) && (out_offset < dec_size); i++) {
+                if((flags << i) & 0x80) {
+                    if((data_size - offset) < 2) {
+                        NTR_R_FAIL(ResultCompressionUnexpectedEndOfData);
+                    }
 
-                    auto length = msb_len >> 4; // 4 high bits
-                    auto disp = ((msb_len & 15) << 8) + lsb; // 4 low bits * 0x100 + lsb
+                    const size_t msb_len = data[offset];
+                    const size_t lsb = data[offset + 1];
+                    auto length = msb_len >> 4;
+                    auto disp = ((msb_len & 15) << 8) + lsb;
+                    auto token_size = 2;
 
                     if(ver == LzVersion::LZ10) {
                         length += 3;
@@ -292,33 +856,48 @@ namespace ntr::util {
                         length++;
                     }
                     else if(length == 0) {
+                        if((data_size - offset) < 3) {
+                            NTR_R_FAIL(ResultCompressionUnexpectedEndOfData);
+                        }
+
                         length = (msb_len & 15) << 4;
                         length += lsb >> 4;
                         length += 0x11;
-                        const size_t msb = data[offset];
-                        offset++;
+                        const size_t msb = data[offset + 2];
                         disp = ((lsb & 15) << 8) + msb;
+                        token_size = 3;
                     }
                     else {
+                        if((data_size - offset) < 4) {
+                            NTR_R_FAIL(ResultCompressionUnexpectedEndOfData);
+                        }
+
                         length = (msb_len & 15) << 12;
                         length += lsb << 4;
-                        const size_t byte_1 = data[offset];
-                        offset++;
-                        const size_t byte_2 = data[offset];
-                        offset++;
+                        const size_t byte_1 = data[offset + 2];
+                        const size_t byte_2 = data[offset + 3];
                         length += byte_1 >> 4;
                         length += 0x111;
                         disp = ((byte_1 & 15) << 8) + byte_2;
+                        token_size = 4;
                     }
+                    offset += token_size;
 
-                    const auto start_offset = out_offset - disp - 1;
-                    for(size_t j = 0; j < length; j++) {
-                        const auto val = out_data[start_offset + j];
-                        out_data[out_offset] = val;
-                        out_offset++;
+                    const auto distance = disp + 1;
+                    if(distance > out_offset) {
+                        NTR_R_FAIL(ResultCompressionInvalidLzFormat);
                     }
+
+                    // Like the streaming decompressor, a back-reference past the end is cut there
+                    length = std::min(length, dec_size - out_offset);
+                    CopyMatch(out_data + out_offset, distance, length, dec_size - out_offset);
+                    out_offset += length;
                 }
                 else {
+                    if(offset >= data_size) {
+                        NTR_R_FAIL(ResultCompressionUnexpectedEndOfData);
+                    }
+
                     out_data[out_offset] = data[offset];
                     offset++;
                     out_offset++;
@@ -326,8 +905,133 @@ namespace ntr::util {
             }
         }
 
+        out_dec_size = dec_size;
         out_used_data_size = offset;
         NTR_R_SUCCEED();
     }
 
-}
\ No newline at end of file
+    Result LzDecompressor::Initialize(const u8 *enc_data, const size_t enc_data_size, size_t &out_header_size) {
+        *this = {};
+        return LzReadHeader(enc_data, enc_data_size, this->ver, this->dec_size, out_header_size);
+    }
+
+    Result LzDecompressor::Decompress(const u8 *enc_data, const size_t enc_data_size, size_t &out_used_enc_size, u8 *out_data, const size_t out_data_size, size_t &out_dec_size) {
+        constexpr size_t WindowMask = WindowSize - 1;
+
+        size_t offset = 0;
+        size_t out_offset = 0;
+        while((out_offset < out_data_size) && (this->dec_offset < this->dec_size)) {
+            if(this->copy_left_size > 0) {
+                // Continue with the current back-reference
+                auto copy_size = std::min(this->copy_left_size, out_data_size - out_offset);
+                copy_size = std::min(copy_size, this->dec_size - this->dec_offset);
+                for(size_t i = 0; i < copy_size; i++) {
+                    const auto val = this->window[(this->dec_offset - this->copy_disp - 1) & WindowMask];
+                    this->window[this->dec_offset & WindowMask] = val;
+                    out_data[out_offset] = val;
+                    out_offset++;
+                    this->dec_offset++;
+                }
+                this->copy_left_size -= copy_size;
+                continue;
+            }
+
+            if(this->cur_flags_left == 0) {
+                if(offset >= enc_data_size) {
+                    break;
+                }
+
+                this->cur_flags = enc_data[offset];
+                offset++;
+                this->cur_flags_left = 8;
+            }
+
+            const auto bit = this->cur_flags_left - 1;
+            if((this->cur_flags >> bit) & 1) {
+                // Back-references are only consumed once they are fully available
+                const auto left_enc_size = enc_data_size - offset;
+                if(left_enc_size < 2) {
+                    break;
+                }
+
+                const size_t msb_len = enc_data[offset];
+                const size_t lsb = enc_data[offset + 1];
+                auto length = msb_len >> 4;
+                auto disp = ((msb_len & 15) << 8) + lsb;
+                auto token_size = 2;
+
+                if(this->ver == LzVersion::LZ10) {
+                    length += 3;
+                }
+                else if(length > 1) {
+                    length++;
+                }
+                else if(length == 0) {
+                    if(left_enc_size < 3) {
+                        break;
+                    }
+
+                    length = (msb_len & 15) << 4;
+                    length += lsb >> 4;
+                    length += 0x11;
+                    const size_t msb = enc_data[offset + 2];
+                    disp = ((lsb & 15) << 8) + msb;
+                    token_size = 3;
+                }
+                else {
+                    if(left_enc_size < 4) {
+                        break;
+                    }
+
+                    length = (msb_len & 15) << 12;
+                    length += lsb << 4;
+                    const size_t byte_1 = enc_data[offset + 2];
+                    const size_t byte_2 = enc_data[offset + 3];
+                    length += byte_1 >> 4;
+                    length += 0x111;
+                    disp = ((byte_1 & 15) << 8) + byte_2;
+                    token_size = 4;
+                }
+
+                if((disp + 1) > this->dec_offset) {
+                    NTR_R_FAIL(ResultCompressionInvalidLzFormat);
+                }
+
+                offset += token_size;
+                this->copy_left_size = length;
+                this->copy_disp = disp;
+            }
+            else {
+                if(offset >= enc_data_size) {
+                    break;
+                }
+
+                const auto val = enc_data[offset];
+                offset++;
+                this->window[this->dec_offset & WindowMask] = val;
+                out_data[out_offset] = val;
+                out_offset++;
+                this->dec_offset++;
+            }
+            this->cur_flags_left--;
+        }
+
+        out_used_enc_size = offset;
+        out_dec_size = out_offset;
+        NTR_R_SUCCEED();
+    }
+
+    Result LzDecompressor::CopyFromWindow(const size_t dec_offset, u8 *out_data, const size_t out_data_size) {
+        constexpr size_t WindowMask = WindowSize - 1;
+
+        if(!this->IsInWindow(dec_offset) || ((dec_offset + out_data_size) > this->dec_offset)) {
+            NTR_R_FAIL(ResultEndOfData);
+        }
+
+        for(size_t i = 0; i < out_data_size; i++) {
+            out_data[i] = this->window[(dec_offset + i) & WindowMask];
+        }
+        NTR_R_SUCCEED();
+    }
+
+}
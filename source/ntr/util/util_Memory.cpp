@@ -0,0 +1,106 @@
+#include <ntr/util/util_Memory.hpp>
+
+namespace ntr::util {
+
+    void ChunkedBuffer::Clear() {
+        for(auto &block: this->blocks) {
+            delete[] block;
+        }
+        this->blocks.clear();
+        this->size = 0;
+    }
+
+    void ChunkedBuffer::Resize(const size_t new_size) {
+        if(new_size > this->size) {
+            // Blocks are allocated zeroed, but space left over by a previous shrink might not be
+            const auto stale_end_offset = std::min(new_size, this->blocks.size() * this->block_size);
+            for(auto offset = this->size; offset < stale_end_offset;) {
+                const auto block_offset = offset % this->block_size;
+                const auto clear_size = std::min(this->block_size - block_offset, stale_end_offset - offset);
+                std::memset(this->blocks[offset / this->block_size] + block_offset, 0, clear_size);
+                offset += clear_size;
+            }
+
+            while((this->blocks.size() * this->block_size) < new_size) {
+                this->blocks.push_back(NewArray<u8>(this->block_size));
+            }
+        }
+
+        this->size = new_size;
+    }
+
+    void ChunkedBuffer::Write(const size_t offset, const void *data, const size_t data_size) {
+        if((offset + data_size) > this->size) {
+            this->Resize(offset + data_size);
+        }
+
+        auto cur_data = reinterpret_cast<const u8*>(data);
+        auto cur_offset = offset;
+        auto cur_left_size = data_size;
+        while(cur_left_size > 0) {
+            const auto block_offset = cur_offset % this->block_size;
+            const auto copy_size = std::min(this->block_size - block_offset, cur_left_size);
+            std::memcpy(this->blocks[cur_offset / this->block_size] + block_offset, cur_data, copy_size);
+            cur_data += copy_size;
+            cur_offset += copy_size;
+            cur_left_size -= copy_size;
+        }
+    }
+
+    void ChunkedBuffer::Fill(const size_t offset, const u8 value, const size_t fill_size) {
+        if((offset + fill_size) > this->size) {
+            const auto old_size = this->size;
+            this->Resize(offset + fill_size);
+
+            // Zeros past the old end were already filled by resizing
+            if((value == 0) && (offset >= old_size)) {
+                return;
+            }
+        }
+
+        auto cur_offset = offset;
+        auto cur_left_size = fill_size;
+        while(cur_left_size > 0) {
+            const auto block_offset = cur_offset % this->block_size;
+            const auto set_size = std::min(this->block_size - block_offset, cur_left_size);
+            std::memset(this->blocks[cur_offset / this->block_size] + block_offset, value, set_size);
+            cur_offset += set_size;
+            cur_left_size -= set_size;
+        }
+    }
+
+    Result ChunkedBuffer::Read(const size_t offset, void *out_data, const size_t data_size) const {
+        if((offset + data_size) > this->size) {
+            NTR_R_FAIL(ResultEndOfData);
+        }
+
+        auto cur_out_data = reinterpret_cast<u8*>(out_data);
+        auto cur_offset = offset;
+        auto cur_left_size = data_size;
+        while(cur_left_size > 0) {
+            const auto block_offset = cur_offset % this->block_size;
+            const auto copy_size = std::min(this->block_size - block_offset, cur_left_size);
+            std::memcpy(cur_out_data, this->blocks[cur_offset / this->block_size] + block_offset, copy_size);
+            cur_out_data += copy_size;
+            cur_offset += copy_size;
+            cur_left_size -= copy_size;
+        }
+
+        NTR_R_SUCCEED();
+    }
+
+    void ChunkedBuffer::CopyTo(u8 *out_data) const {
+        auto cur_left_size = this->size;
+        for(const auto &block: this->blocks) {
+            if(cur_left_size == 0) {
+                break;
+            }
+
+            const auto copy_size = std::min(this->block_size, cur_left_size);
+            std::memcpy(out_data, block, copy_size);
+            out_data += copy_size;
+            cur_left_size -= copy_size;
+        }
+    }
+
+}
@@ -404,10 +404,10 @@ namespace ui::menu {
                     }
                 });
 
-                auto old_gfx_data = ncgr.data;
-                ncgr.data = ntr::util::NewArray<u8>(ctx_2.out_gfx_data_size);
+                auto new_gfx_data = ntr::util::NewArray<u8>(ctx_2.out_gfx_data_size);
+                ncgr.DisposeData();
+                ncgr.data = new_gfx_data;
                 ncgr.char_data.data_size = ctx_2.out_gfx_data_size;
-                delete[] old_gfx_data;
                 std::memcpy(ncgr.data, ctx_2.out_gfx_data, ncgr.char_data.data_size);
                 rc = SaveNormalFile(ncgr, "NCGR");
                 if(rc.IsFailure()) {
@@ -415,10 +415,10 @@ namespace ui::menu {
                     return;
                 }
 
-                auto old_plt_data = nclr.data;
-                nclr.data = ntr::util::NewArray<u8>(ctx_2.out_plt_data_size);
+                auto new_plt_data = ntr::util::NewArray<u8>(ctx_2.out_plt_data_size);
+                nclr.DisposeData();
+                nclr.data = new_plt_data;
                 nclr.palette.data_size = ctx_2.out_plt_data_size;
-                delete[] old_plt_data;
                 std::memcpy(nclr.data, ctx_2.out_plt_data, nclr.palette.data_size);
                 rc = SaveNormalFile(nclr, "NCLR");
                 if(rc.IsFailure()) {
@@ -427,10 +427,10 @@ namespace ui::menu {
                 }
 
                 if(has_nscr) {
-                    auto old_scr_data = std::move(nscr.data);
-                    nscr.data = ntr::util::NewArray<u8>(ctx_2.out_scr_data_size);
+                    auto new_scr_data = ntr::util::NewArray<u8>(ctx_2.out_scr_data_size);
+                    nscr.DisposeData();
+                    nscr.data = new_scr_data;
                     nscr.screen_data.data_size = ctx_2.out_scr_data_size;
-                    delete[] old_scr_data;
                     std::memcpy(nscr.data, ctx_2.out_scr_data, nscr.screen_data.data_size);
                     rc = SaveNormalFile(nscr, "NSCR");
                     if(rc.IsFailure()) {
@@ -659,11 +659,11 @@ namespace ui::menu {
     void LoadStdioFileBrowseMenu(const std::string &base_dir) {
         g_CurrentDirectory = base_dir;
         std::vector<ScrollMenuEntry> entries;
-		FS_FOR_EACH_STDIO_ENTRY(base_dir, {
-            if((entry_name == ".") || (entry_name == "..")) {
-                continue;
-            }
-            if(is_dir) {
+        ntr::fs::StdioFileSystemIterator it(base_dir);
+        while(it.Next()) {
+            const std::string entry_name = it.GetEntryName();
+            const auto &entry_path = it.GetEntryPath();
+            if(it.IsDirectory()) {
                 entries.push_back({
                     .icon_gfx = g_DirectoryIconGfx,
                     .text = entry_name,
@@ -671,10 +671,10 @@ namespace ui::menu {
                     .on_focus = std::bind(OnItemFocus, true, entry_path, false)
                 });
             }
-            else if(is_file) {
+            else if(it.IsFile()) {
                 LoadFileEntryImpl(true, entry_name, entry_path, entries);
             }
-        });
+        }
 
         LoadScrollMenu(entries, OnOtherStdioInput);
         EnableScrollMenuSelection(std::bind(OnSelect, true, std::placeholders::_1));
@@ -28,7 +28,7 @@ namespace ui::menu {
         const auto swar_count = sdat->wav_arc_info_record.entry_count;
         const auto has_symb = sdat->HasSymbols();
         for(u32 i = 0; i < swar_count; i++) {
-            const auto base_name = has_symb ? sdat->wav_arc_symb_record.entries[i].name : std::to_string(i);
+            const auto base_name = has_symb ? std::string(sdat->wav_arc_symb_record.entries[i].name) : std::to_string(i);
             const auto disp_name = has_symb ? base_name : "Wave archive " + base_name;
             g_MenuEntries.push_back({
                 .icon_gfx = music_icon_gfx,